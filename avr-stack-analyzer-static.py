@@ -14,16 +14,31 @@ python3 --version
 # Pamata izmantojums
 python3 avr-stack-analyzer-static.py program.c -m atmega328p -r 2048 -o O0
 
+# Nokompilēta attēla (ELF vai Intel HEX, arī bez simboliem) analīze
+python3 avr-stack-analyzer-static.py firmware.hex -m atmega328p -r 2048
+
+# Attēls ar rekursīvu funkciju: dziļums jānorāda, jo pirmkods nav pieejams
+python3 avr-stack-analyzer-static.py firmware.hex -m atmega328p --recursion-limit sub_000a4=8
+
 # Palīdzības parādīšana (rāda visus pieejamos karogus un to aprakstus)
 python3 avr-stack-analyzer-static.py --help
 
 # Pieiejami karogi
 -h vai --help parāda palīdzības ziņojumu ar visu argumentu aprakstiem
 -m vai --mcu norāda mikrokontrolleru tipu (noklusējums: atmega328p)
--r vai --ram norāda RAM izmēru baitos (noklusējums: 2048)
+-r vai --ram norāda RAM izmēru baitos (noklusējums: 2048; ar --bootloader vai --xmem-size: no ierīces galvenes)
 -o vai --optimization norāda optimizācijas līmeni: O0, O1, O2, O3, Os, Og, Ofast, Oz (noklusējums: O0)
 -c vai --compiler-flags ļauj nodot papildu kompilatora karogus
 -l vai --log-level norāda logging līmeni (noklusējums: warning)
+--cache-dir norāda direktoriju analīzes starprezultātu kešošanai
+-b vai --bootloader norāda sāknēšanas ielādētāja C vai ELF failu kopīgai analīzei ar lietotni
+--bootloader-flags ļauj nodot papildu kompilatora karogus sāknēšanas ielādētājam
+--ram-start norāda pirmo SRAM adresi (noklusējums: RAMSTART no ierīces galvenes)
+--trace ieraksta Chrome trace-event JSON failu ar posmu un apakšprocesu laikiem
+--breakdown parāda steka izmantojuma sadalījumu pa direktorijām, bibliotēkām un avota failiem
+--xmem-size norāda ārējās SRAM izmēru un pārbauda, vai steks paliek iekšējā SRAM
+--xmem-start norāda ārējās SRAM sākuma adresi (noklusējums: uzreiz aiz iekšējās SRAM)
+--recursion-limit FUNC=N norāda rekursīvās funkcijas dziļumu (attēliem bez pirmkoda), var atkārtot
 """
 
 import subprocess
@@ -33,6 +48,16 @@ import argparse
 import tempfile
 import shutil
 import logging
+import hashlib
+import json
+import base64
+import struct
+import time
+import threading
+import itertools
+from collections import Counter
+from contextlib import contextmanager, nullcontext
+from dataclasses import dataclass, fields, replace
 
 def setup_logging(log_level):
     """Uzstāda žurnālošanu ar norādīto līmeni."""
@@ -57,6 +82,387 @@ def setup_logging(log_level):
 
 logger = logging.getLogger('avr_stack_analyzer')
 
+class TraceRecorder:
+    """Ieraksta Chrome trace-event notikumus (atverami Perfetto vai chrome://tracing)."""
+
+    def __init__(self):
+        self.events = []
+        self.lock = threading.Lock()
+        self.pid = os.getpid()
+
+    def emit(self, phase, name, category, args):
+        # Laiks mikrosekundēs no epohas, lai dažādu procesu notikumus varētu apvienot
+        event = {
+            'name': name,
+            'cat': category,
+            'ph': phase,
+            'ts': time.time_ns() // 1000,
+            'pid': self.pid,
+            'tid': threading.get_native_id(),
+            'args': args
+        }
+        with self.lock:
+            self.events.append(event)
+
+    @contextmanager
+    def span(self, name, category="phase", **args):
+        """Ieraksta sākuma un beigu notikumu. Beigu notikumam var pievienot argumentus caur atgriezto vārdnīcu."""
+        self.emit('B', name, category, args)
+        end_args = {}
+        try:
+            yield end_args
+        finally:
+            self.emit('E', name, category, end_args)
+
+    def write(self, path):
+        with open(path, 'w') as f:
+            json.dump({'traceEvents': self.events, 'displayTimeUnit': 'ms'}, f)
+
+# Aktīvais trace ierakstītājs (None, ja trasēšana nav ieslēgta)
+tracer = None
+
+def enable_tracing():
+    """Ieslēdz trace notikumu ierakstīšanu un atgriež ierakstītāju."""
+    global tracer
+    tracer = TraceRecorder()
+    return tracer
+
+def trace_span(name, category="phase", **args):
+    """Atgriež trace posma kontekstu vai tukšu kontekstu, ja trasēšana izslēgta."""
+    if tracer is None:
+        return nullcontext({})
+    return tracer.span(name, category, **args)
+
+# Kompilatora karogi, kuru vērtība ir ceļš (kompilācija notiek pagaidu direktorijā)
+PATH_FLAGS = ('-I', '-L', '-isystem', '-iquote', '-idirafter', '-include', '-imacros')
+
+def absolute_path_flags(flags, base_dir=None):
+    """
+    Pārveido relatīvos ceļus karogos (-Iinc, -I inc, -include cfg.h) par absolūtiem attiecībā pret
+    base_dir (noklusējums: pašreizējā direktorija). Absolūtie ceļi netiek mainīti.
+    """
+    def absolute(path):
+        return os.path.abspath(os.path.join(base_dir, path) if base_dir else path)
+    
+    result = []
+    expects_path = False
+    for flag in flags:
+        if expects_path:
+            result.append(absolute(flag))
+            expects_path = False
+        elif flag in PATH_FLAGS:
+            result.append(flag)
+            expects_path = True
+        else:
+            prefix = next((prefix for prefix in ('-I', '-L') if flag.startswith(prefix)), None)
+            result.append(prefix + absolute(flag[len(prefix):]) if prefix else flag)
+    return result
+
+def run_tool(cmd, **kwargs):
+    """Palaiž ārējo rīku (avr-gcc, avr-objdump, avr-size) un ieraksta to trace failā."""
+    with trace_span(os.path.basename(cmd[0]), category="subprocess", command=" ".join(cmd)):
+        return subprocess.run(cmd, **kwargs)
+
+# AVR datu atmiņas adrešu nobīdes ELF failā
+DATA_MEMORY_OFFSET = 0x800000
+EEPROM_MEMORY_OFFSET = 0x810000
+
+# avr-libc malloc parametri
+ALLOCATOR_FUNCTIONS = {'malloc', 'calloc', 'realloc', 'free'}
+DEFAULT_MALLOC_MARGIN = 32
+MALLOC_HEADER_SIZE = 2
+MALLOC_MIN_CHUNK = 2
+
+# Nokompilētu attēlu paplašinājumi (analīze bez kompilācijas)
+IMAGE_EXTENSIONS = ('.elf', '.hex', '.ihex')
+
+# avr-objdump arhitektūras biežāk lietotajiem mikrokontrolieriem (Intel HEX disasamblēšanai)
+MCU_ARCHITECTURES = {
+    'attiny13': 'avr25', 'attiny85': 'avr25', 'attiny2313': 'avr25',
+    'atmega8': 'avr4', 'atmega48': 'avr4', 'atmega88': 'avr4',
+    'atmega168': 'avr5', 'atmega328': 'avr5', 'atmega328p': 'avr5', 'atmega32': 'avr5',
+    'atmega32u4': 'avr5', 'atmega644p': 'avr5', 'atmega1284p': 'avr51',
+    'atmega1280': 'avr6', 'atmega2560': 'avr6',
+    'atxmega32a4': 'avrxmega2', 'atxmega128a1': 'avrxmega7',
+}
+
+# Arhitektūras ar 22 bitu programmas skaitītāju: atgriešanās adrese stekā aizņem 3 baitus
+LARGE_PC_ARCHITECTURES = ('avr6', 'avrxmega6', 'avrxmega7')
+
+# ELF e_machine vērtība AVR un e_flags arhitektūras lauka maska (EF_AVR_MACH)
+EM_AVR = 83
+EF_AVR_MACH = 0x7f
+
+def avr_architecture_name(arch):
+    """Pārveido arhitektūras numuru (__AVR_ARCH__, ELF e_flags) par avr-objdump nosaukumu: 5 -> avr5, 106 -> avrxmega6."""
+    if arch == 100:
+        return "avrtiny"
+    return f"avrxmega{arch - 100}" if arch > 100 else f"avr{arch}"
+
+def elf_architecture(elf_image):
+    """
+    Nolasa arhitektūru no AVR ELF galvenes e_flags (to pašu vērtību avr-objdump -f rāda kā avr:5, avr:6).
+    Atgriež None Intel HEX failam vai ELF bez arhitektūras.
+    """
+    if len(elf_image) < 40 or elf_image[:4] != b'\x7fELF':
+        return None
+    byte_order = '<' if elf_image[5] == 1 else '>'
+    machine = struct.unpack_from(byte_order + 'H', elf_image, 18)[0]
+    flags = struct.unpack_from(byte_order + 'I', elf_image, 36)[0]
+    if machine != EM_AVR or not flags & EF_AVR_MACH:
+        return None
+    return avr_architecture_name(flags & EF_AVR_MACH)
+
+# XMEGA PMIC pārtraukumu līmeņi (zemākais līdz augstākajam)
+INTERRUPT_LEVELS = ('low', 'medium', 'high')
+
+# avr-gcc ABI: argumenti reģistros r25..r8, atgriežamā vērtība līdz 8 baitiem reģistros
+ARGUMENT_REGISTER_BYTES = 18
+MAX_RETURN_REGISTER_BYTES = 8
+# Steka argumentu attīrīšana: līdz 6 baitiem ar POP, citādi ar SP korekciju (~8 cikli)
+SMALL_STACK_CLEANUP_BYTES = 6
+SP_ADJUST_CYCLES = 8
+
+# Instrukcijas šablons: adrese, mnemonika un operandi (bez komentāra)
+instruction_pattern = re.compile(r'^\s*[0-9a-f]+:\s+(?:[0-9a-f]{2}\s)+\s*([a-z]+)\s*([^;]*)')
+
+# Instrukcijas, kuru pirmais reģistra operands netiek mainīts
+NON_WRITING_INSTRUCTIONS = {'cp', 'cpc', 'cpi', 'cpse', 'tst', 'push', 'st', 'std', 'sts', 'out', 'sbrc', 'sbrs', 'bst'}
+
+# avr-gcc ABI: reģistri, ko izsauktā funkcija drīkst mainīt (r0, r18-r27, r30-r31)
+CALL_CLOBBERED_REGISTERS = (0, *range(18, 28), 30, 31)
+
+# Vadības plūsma: nosacījuma un beznosacījuma lēcieni, atgriešanās un instrukcijas, kas var izlaist nākamo
+UNCONDITIONAL_JUMPS = {'rjmp', 'jmp', 'ijmp', 'eijmp', 'ret', 'reti'}
+SKIP_INSTRUCTIONS = {'cpse', 'sbrc', 'sbrs', 'sbic', 'sbis'}
+CALL_INSTRUCTIONS = {'call', 'rcall', 'icall', 'eicall'}
+
+def is_call(mnemonic, operands):
+    """Vai instrukcija ir funkcijas izsaukums (rcall .+0 tikai rezervē vietu stekā)."""
+    return mnemonic in CALL_INSTRUCTIONS and not (mnemonic == 'rcall' and operands and operands[0] == '.+0')
+
+def track_register_constants(line, registers):
+    """Atjauno zināmās reģistru konstantes ({reģistrs: vērtība}) pēc vienas instrukcijas."""
+    match = instruction_pattern.match(line)
+    if not match:
+        return
+    mnemonic, operands = match.group(1), [op.strip() for op in match.group(2).split(',')]
+    if is_call(mnemonic, operands):
+        # Izsauktā funkcija var mainīt argumentu un pagaidu reģistrus
+        for register in CALL_CLOBBERED_REGISTERS:
+            registers.pop(register, None)
+        return
+    dest_match = re.match(r'r(\d+)$', operands[0]) if operands else None
+    if not dest_match or mnemonic in NON_WRITING_INSTRUCTIONS:
+        return
+    
+    dest = int(dest_match.group(1))
+    if mnemonic == 'ldi' and len(operands) > 1:
+        try:
+            registers[dest] = int(operands[1], 0) & 0xFF
+        except ValueError:
+            registers.pop(dest, None)
+    elif mnemonic in ('eor', 'sub') and len(operands) > 1 and operands[1] == operands[0]:
+        registers[dest] = 0
+    elif mnemonic == 'mov' and len(operands) > 1 and re.match(r'r\d+$', operands[1]):
+        registers[dest] = registers.get(int(operands[1][1:]))
+    elif mnemonic == 'movw' and len(operands) > 1 and re.match(r'r\d+$', operands[1]):
+        source = int(operands[1][1:])
+        registers[dest] = registers.get(source)
+        registers[dest + 1] = registers.get(source + 1)
+    elif mnemonic in ('adiw', 'sbiw'):
+        registers.pop(dest, None)
+        registers.pop(dest + 1, None)
+    else:
+        registers.pop(dest, None)
+    
+    if registers.get(dest) is None:
+        registers.pop(dest, None)
+
+def register_pair_value(registers, low):
+    """Atgriež 16 bitu vērtību no reģistru pāra (low, low+1) vai None, ja tā nav zināma."""
+    if low in registers and low + 1 in registers:
+        return registers[low] | (registers[low + 1] << 8)
+    return None
+
+# Funkcijas vai atzīmes galvene un instrukcijas adrese disasamblētajā kodā
+function_header_pattern = re.compile(r'^([0-9a-f]+) <([^>]+)>:')
+instruction_address_pattern = re.compile(r'^\s*([0-9a-f]+):')
+
+def split_functions(asm_code):
+    """
+    Sadala disasamblēto kodu pa funkcijām: {funkcija: [(adrese, mnemonika, operandi, rinda), ...]}.
+    Kompilatora atzīmes (.L, ^) nesāk jaunu funkciju, bet to adreses ir iespējamie lēcienu mērķi.
+    Atgriež (funkcijas, atzīmju adrešu kopa).
+    """
+    functions = {}
+    labels = set()
+    current = None
+    for line in asm_code.split('\n'):
+        header = function_header_pattern.match(line)
+        if header:
+            name = header.group(2)
+            if '^' in name or name.startswith('.L'):
+                labels.add(int(header.group(1), 16))
+            else:
+                current = functions.setdefault(name, [])
+            continue
+        match = instruction_pattern.match(line)
+        if current is None or not match:
+            continue
+        address = int(instruction_address_pattern.match(line).group(1), 16)
+        operands = [op.strip() for op in match.group(2).split(',')] if match.group(2).strip() else []
+        current.append((address, match.group(1), operands, line))
+    return functions, labels
+
+def branch_target(address, mnemonic, operands):
+    """Atgriež lēciena mērķa baitu adresi (rjmp .-4, breq .+2, jmp 0x1a4) vai None."""
+    if not operands or not (mnemonic.startswith('br') or mnemonic in ('rjmp', 'jmp')):
+        return None
+    target = operands[-1]
+    relative = re.fullmatch(r'\.([+-]\d+)', target)
+    if relative:
+        return address + 2 + int(relative.group(1))
+    if re.fullmatch(r'0x[0-9a-f]+', target):
+        return int(target, 16)
+    return None
+
+def control_flow(instructions, labels=()):
+    """
+    Nosaka funkcijas apvienošanās punktus (lēcienu mērķi, atzīmes, instrukcijas pēc beznosacījuma
+    lēciena vai izlaižamas instrukcijas) un ciklus (atpakaļejošu lēcienu adrešu intervālus).
+    Atgriež (apvienošanās adrešu kopa, [(cikla sākums, cikla beigas), ...]).
+    """
+    if not instructions:
+        return set(), []
+    start, end = instructions[0][0], instructions[-1][0]
+    joins = {label for label in labels if start < label <= end}
+    loops = []
+    for index, (address, mnemonic, operands, _) in enumerate(instructions):
+        target = branch_target(address, mnemonic, operands)
+        if target is not None and start <= target <= end:
+            joins.add(target)
+            if target <= address:
+                loops.append((target, address))
+        if mnemonic in UNCONDITIONAL_JUMPS and index + 1 < len(instructions):
+            joins.add(instructions[index + 1][0])
+        if mnemonic in SKIP_INSTRUCTIONS and index + 2 < len(instructions):
+            joins.add(instructions[index + 2][0])
+    return joins, loops
+
+def in_loop(address, loops):
+    """Vai adrese atrodas kādā no funkcijas cikliem."""
+    return any(loop_start <= address <= loop_end for loop_start, loop_end in loops)
+
+def call_graph_components(call_graph):
+    """
+    Izsaukumu grafa stipri saistītās komponentes (Tarjana algoritms bez rekursijas).
+    Atgriež vārdnīcu funkcija -> komponentes numurs; funkcijas vienā ciklā saņem vienu numuru.
+    """
+    index, lowlink, component = {}, {}, {}
+    stack, on_stack, roots_found = [], set(), []
+    for root in list(call_graph):
+        if root in index:
+            continue
+        work = [(root, iter(call_graph.get(root, [])))]
+        index[root] = lowlink[root] = len(index)
+        stack.append(root)
+        on_stack.add(root)
+        while work:
+            func_name, callees = work[-1]
+            for callee in callees:
+                if callee not in index:
+                    index[callee] = lowlink[callee] = len(index)
+                    stack.append(callee)
+                    on_stack.add(callee)
+                    work.append((callee, iter(call_graph.get(callee, []))))
+                    break
+                if callee in on_stack:
+                    lowlink[func_name] = min(lowlink[func_name], index[callee])
+            else:
+                work.pop()
+                if work:
+                    caller = work[-1][0]
+                    lowlink[caller] = min(lowlink[caller], lowlink[func_name])
+                if lowlink[func_name] == index[func_name]:
+                    number = len(roots_found)
+                    roots_found.append(func_name)
+                    while True:
+                        member = stack.pop()
+                        on_stack.discard(member)
+                        component[member] = number
+                        if member == func_name:
+                            break
+    return component
+
+# GCC klonu sufiksi: process.constprop.0, filter.isra.0, handler.part.1, main.cold, helper.lto_priv.0
+clone_suffix_pattern = re.compile(r'\.(constprop|isra|part|cold|lto_priv|localalias|clone)(?:\.(\d+))?')
+
+def parse_clone_name(symbol):
+    """Sadala simbola nosaukumu izcelsmes funkcijā un GCC klonu sufiksu sarakstā [(veids, numurs vai None)]."""
+    match = clone_suffix_pattern.search(symbol)
+    if not match:
+        return symbol, ()
+    suffixes = tuple(
+        (suffix.group(1), int(suffix.group(2)) if suffix.group(2) else None)
+        for suffix in clone_suffix_pattern.finditer(symbol, match.start())
+    )
+    return symbol[:match.start()], suffixes
+
+class SymbolIndex:
+    """
+    Kartē assemblera simbolus uz .su ierakstiem O(1) laikā: vispirms precīza sakritība,
+    tad klona atslēga bez numuriem (.su var saturēt 'process.constprop' bez '.0').
+    Kloni paliek atsevišķas funkcijas ar savu ietvaru; '.cold' daļa pieder savai funkcijai.
+    """
+
+    def __init__(self, names):
+        self.names = set(names)
+        self.by_clone_key = {}
+        self.by_origin = {}
+        for name in sorted(self.names):
+            origin, suffixes = parse_clone_name(name)
+            # Numurēts .su ieraksts atbilst tikai tieši šim klonam
+            if all(number is None for _, number in suffixes):
+                self.by_clone_key.setdefault(self.clone_key(origin, suffixes), name)
+            if not suffixes:
+                self.by_origin[origin] = name
+
+    @staticmethod
+    def clone_key(origin, suffixes):
+        return origin + "".join(f".{kind}" for kind, _ in suffixes)
+
+    def resolve(self, symbol):
+        """Atgriež simbola paša .su ierakstu vai None."""
+        if symbol in self.names:
+            return symbol
+        return self.by_clone_key.get(self.clone_key(*parse_clone_name(symbol)))
+
+    def owner(self, symbol):
+        """Atgriež funkciju, kurai pieder simbola kods ('.cold' daļa pieder funkcijai, no kuras tā atdalīta)."""
+        resolved = self.resolve(symbol)
+        if resolved is not None:
+            return resolved
+        origin, suffixes = parse_clone_name(symbol)
+        if suffixes and suffixes[-1][0] == 'cold':
+            return self.resolve(self.clone_key(origin, suffixes[:-1]) if len(suffixes) > 1 else origin)
+        return None
+
+    def origin(self, symbol):
+        """Atgriež izcelsmes funkcijas .su ierakstu klonam bez sava ieraksta vai None."""
+        return self.by_origin.get(parse_clone_name(symbol)[0])
+
+    def node(self, symbol):
+        """
+        Atgriež izsaukumu grafa virsotni simbolam: funkciju, kurai pieder tā kods, vai pašu klonu,
+        ja tam nav sava .su ieraksta, bet izcelsme ir zināma (filter.isra.1, kad .su ir tikai filter).
+        """
+        owner = self.owner(symbol)
+        if owner is not None or self.origin(symbol) is None:
+            return owner
+        # Klona '.cold' daļa pieder pašam klonam
+        return re.sub(r'\.cold(?:\.\d+)?$', '', symbol)
+
 class AVRCStackAnalyzer:
     def __init__(self, source_file, mcu_type="atmega328p", ram_size=2048, optimization="O0", compiler_flags=None):
         """Inicializē analizatoru ar C pirmkoda failu un mikrokontroliera tipu."""
@@ -69,6 +475,16 @@ class AVRCStackAnalyzer:
         # Pagaidu direktorija kompilācijas artefaktiem
         self.temp_dir = tempfile.mkdtemp(prefix="avr_stack_analyzer_")
         self.elf_file = os.path.join(self.temp_dir, os.path.splitext(os.path.basename(source_file))[0] + ".elf")
+        self.map_file = os.path.join(self.temp_dir, os.path.splitext(os.path.basename(source_file))[0] + ".map")
+        
+        # Funkciju izcelsmes faili no .su failiem (aizpilda collect_stack_usage_reports)
+        self.stack_usage_files = {}
+        
+        # Lietotāja norādītie rekursijas dziļumi {funkcija: dziļums}
+        self.recursion_overrides = {}
+        
+        # Ierīces informācijas kešs (galvenes makrodefinīcijas, arhitektūra)
+        self.device_cache = {}
         
         # Pārbauda, vai fails eksistē
         if not os.path.isfile(source_file):
@@ -87,10 +503,31 @@ class AVRCStackAnalyzer:
 
     def __del__(self):
         """Iztīra pagaidu failus, kad objekts tiek iznīcināts."""
-        if hasattr(self, 'temp_dir') and os.path.exists(self.temp_dir):
+        if getattr(self, 'temp_dir', None) and os.path.exists(self.temp_dir):
             shutil.rmtree(self.temp_dir)
             logger.debug(f"Cleaned up temporary directory: {self.temp_dir}")
-    
+
+    @classmethod
+    def for_artifact(cls, build_artifact, ram_size=2048):
+        """Izveido analizatoru jau nokompilētam artefaktam (bez kompilācijas un pagaidu direktorijas)."""
+        analyzer = cls.__new__(cls)
+        analyzer.source_file = build_artifact.source_file
+        analyzer.mcu_type = build_artifact.mcu_type
+        analyzer.ram_size = ram_size
+        analyzer.optimization = build_artifact.optimization
+        analyzer.compiler_flags = list(build_artifact.compiler_flags)
+        analyzer.source_content = build_artifact.source_content
+        analyzer.temp_dir = None
+        analyzer.elf_file = None
+        analyzer.map_file = None
+        analyzer.stack_usage_files = {}
+        analyzer.recursion_overrides = dict(build_artifact.recursion_limits)
+        analyzer.device_cache = {}
+        architecture = elf_architecture(build_artifact.elf_image)
+        if architecture is not None:
+            analyzer.device_cache['architecture'] = architecture
+        return analyzer
+
     def check_required_tools(self):
         """Pārbauda, vai visi nepieciešamie rīki ir uzstādīti un pieejami."""
         required_tools = ["avr-gcc", "avr-objdump", "avr-size"]
@@ -139,34 +576,39 @@ class AVRCStackAnalyzer:
         # Pievieno steka izmantojuma karogu papildu analīzei
         cmd.extend(["-fstack-usage"])
         
+        # Linkera karte funkciju izcelsmes (objekta faila un bibliotēkas) noteikšanai
+        cmd.extend([f"-Wl,-Map={self.map_file}"])
+        
         # Pievieno iekļaušanas direktorijas
         if include_dirs:
             for inc_dir in include_dirs:
-                cmd.extend(["-I", inc_dir])
+                cmd.extend(["-I", os.path.abspath(inc_dir)])
         
         # Pievieno bibliotēku direktorijas
         if library_dirs:
             for lib_dir in library_dirs:
-                cmd.extend(["-L", lib_dir])
+                cmd.extend(["-L", os.path.abspath(lib_dir)])
         
-        # Pievieno papildu kompilatora karogus
-        cmd.extend(self.compiler_flags)
+        # Pievieno papildu kompilatora karogus (relatīvie ceļi attiecas pret izsaucēja direktoriju)
+        cmd.extend(absolute_path_flags(self.compiler_flags))
         
         # Pievieno izvades failu
         cmd.extend(["-o", self.elf_file])
         
         # Pievieno avota failu
-        cmd.append(self.source_file)
+        cmd.append(os.path.abspath(self.source_file))
         
         logger.info(f"Compiler command: {' '.join(cmd)}")
 
-        # Veic kompilāciju
+        # Veic kompilāciju pagaidu direktorijā: vecāki avr-gcc .su failus raksta darba direktorijā,
+        # tāpēc paralēlas kompilācijas ar vienādu faila nosaukumu nepārraksta cita citas .su
         try:
-            result = subprocess.run(
+            result = run_tool(
                 cmd,
                 capture_output=True,
                 text=True,
-                check=True
+                check=True,
+                cwd=self.temp_dir
             )
             logger.debug(f"Compilation output: {result.stdout}")
             return True
@@ -179,17 +621,12 @@ class AVRCStackAnalyzer:
         # Atrod avota faila bāzes nosaukumu
         base_name = os.path.splitext(os.path.basename(self.source_file))[0]
 
-        # Iespējamās .su faila atrašanās vietas
+        # Iespējamās .su faila atrašanās vietas: tikai pagaidu direktorijs, kurā notiek kompilācija
+        # (.su faili avota vai darba direktorijā var būt no citas kompilācijas)
         possible_locations = [
-            # Sākotnējais avota direktorijs
-            os.path.join(os.path.dirname(self.source_file), f"{base_name}.su"),
-            # Pārbauda arī ar .elf prefiksu
-            os.path.join(os.path.dirname(self.source_file), f"{base_name}.elf-{base_name}.su"),
-            # Pašreizējais darba direktorijs
-            os.path.join(os.getcwd(), f"{base_name}.su"),
-            os.path.join(os.getcwd(), f"{base_name}.elf-{base_name}.su"),
-            # Pagaidu direktorijs
+            # GCC < 11: darba direktorijs
             os.path.join(self.temp_dir, f"{base_name}.su"),
+            # GCC >= 11: ar izvades faila prefiksu
             os.path.join(self.temp_dir, f"{base_name}.elf-{base_name}.su")
         ]
 
@@ -223,6 +660,8 @@ class AVRCStackAnalyzer:
                         if func_match:
                             function_name = func_match.group(1)
                             function_usage[function_name] = usage
+                            # Saglabā avota failu, kurā funkcija definēta
+                            self.stack_usage_files[function_name] = line.split(':', 1)[0]
                             logger.debug(f"Function: {function_name}, Stack usage: {usage} bytes")
                     except ValueError:
                         logger.warning(f"Skipping malformed line: {line.strip()}")
@@ -241,7 +680,7 @@ class AVRCStackAnalyzer:
         """ Disasamble AVR kodu izmantojot avr-objdump."""
         logger.info("Static Analysis: Disassembling code...")
         
-        result = subprocess.run(
+        result = run_tool(
             ["avr-objdump", "-d", self.elf_file], 
             capture_output=True, 
             text=True, 
@@ -250,6 +689,217 @@ class AVRCStackAnalyzer:
         self.asm_code = result.stdout
         return result.stdout
 
+    def get_avr_architecture(self):
+        """
+        Nosaka avr-objdump arhitektūru (-m avrN): no ELF galvenes, ja tāda ir, citādi no mikrokontroliera
+        tipa (tabula vai avr-gcc makrodefinīcija __AVR_ARCH__). Rezultāts tiek saglabāts analizatorā.
+        """
+        if 'architecture' in self.device_cache:
+            return self.device_cache['architecture']
+        
+        architecture = None
+        if self.elf_file and os.path.isfile(self.elf_file):
+            with open(self.elf_file, 'rb') as f:
+                architecture = elf_architecture(f.read(64))
+        mcu = self.mcu_type.lower()
+        if architecture is None and mcu in MCU_ARCHITECTURES:
+            architecture = MCU_ARCHITECTURES[mcu]
+        
+        if architecture is None:
+            # Citām ierīcēm arhitektūru nosaka avr-gcc makrodefinīcija __AVR_ARCH__
+            try:
+                result = run_tool(
+                    ["avr-gcc", f"-mmcu={mcu}", "-E", "-dM", "-x", "c", "-"],
+                    input="", capture_output=True, text=True
+                )
+            except OSError:
+                result = None
+            arch_match = re.search(r'#define __AVR_ARCH__ (\d+)', result.stdout) if result and result.returncode == 0 else None
+            if not arch_match:
+                raise RuntimeError(f"Unknown AVR architecture for MCU '{self.mcu_type}'")
+            architecture = avr_architecture_name(int(arch_match.group(1)))
+        
+        self.device_cache['architecture'] = architecture
+        return architecture
+
+    def return_address_size(self):
+        """
+        Atgriešanās adreses izmērs baitos: 3 ierīcēm ar 22 bitu PC (piem., ATmega2560), citām 2.
+        Ja arhitektūru nevar noteikt, tiek pieņemti 2 baiti un izvadīts brīdinājums.
+        """
+        if 'return_address_size' not in self.device_cache:
+            try:
+                size = 3 if self.get_avr_architecture() in LARGE_PC_ARCHITECTURES else 2
+            except RuntimeError as e:
+                logger.warning(f"{e}, assuming 2-byte return addresses")
+                size = 2
+            self.device_cache['return_address_size'] = size
+        return self.device_cache['return_address_size']
+
+    def disassemble_ihex(self):
+        """Disasamblē Intel HEX attēlu (bez simboliem) izmantojot avr-objdump."""
+        logger.info("Static Analysis: Disassembling Intel HEX image...")
+        
+        result = run_tool(
+            ["avr-objdump", "-D", "-b", "ihex", "-m", self.get_avr_architecture(), self.elf_file],
+            capture_output=True,
+            text=True,
+            check=True
+        )
+        self.asm_code = result.stdout
+        return result.stdout
+
+    def recover_functions(self, asm_code):
+        """
+        Atjauno funkcijas attēlam bez simboliem: sāk no vektoru tabulas (reset -> main, pārtraukumu
+        apstrādātāji __vector_N) un rekursīvi seko izsaukumu mērķiem (sub_XXXXX), katrā funkcijā
+        ejot pa zariem līdz ret/reti. Atgriež (disasamblētais kods ar sintētiskiem simboliem,
+        statisko datu izmēri no startēšanas koda vai None).
+        """
+        line_pattern = re.compile(
+            r'^\s*([0-9a-f]+):\s+((?:[0-9a-f]{2} )+)\s*([a-z]+)\b\s*([^;]*?)\s*(?:;\s*(.*))?$'
+        )
+        
+        # Instrukcijas adrešu secībā: adrese -> (mnemonika, operandi, komentārs, rinda)
+        instructions = {}
+        for line in asm_code.split('\n'):
+            match = line_pattern.match(line)
+            if match:
+                addr, _, mnemonic, operands, comment = match.groups()
+                instructions[int(addr, 16)] = (mnemonic, operands, comment or "", line)
+        addresses = sorted(instructions)
+        next_address = dict(zip(addresses, addresses[1:]))
+        
+        def target(addr):
+            """Lēciena/izsaukuma mērķa adrese no operanda vai komentāra."""
+            _, operands, comment, _ = instructions[addr]
+            relative = re.match(r'\.([+-]\d+)', operands)
+            if relative:
+                return addr + 2 + int(relative.group(1))
+            absolute = re.search(r'0x([0-9a-f]+)', operands) or re.search(r'0x([0-9a-f]+)', comment)
+            return int(absolute.group(1), 16) if absolute else None
+        
+        # Vektoru tabula: secīgas jmp/rjmp instrukcijas no adreses 0
+        vectors = []
+        addr = 0
+        while addr in instructions and instructions[addr][0] in ('jmp', 'rjmp'):
+            vectors.append(target(addr))
+            addr = next_address.get(addr, -1)
+        if not vectors:
+            raise RuntimeError("No interrupt vector table found at address 0, cannot recover functions")
+        
+        def explore(start, function_starts):
+            """Seko funkcijas zariem. Atgriež (instrukciju adreses, izsaukumu mērķi)."""
+            reached = set()
+            calls = []
+            pending = [start]
+            while pending:
+                addr = pending.pop()
+                if addr in reached or addr not in instructions:
+                    continue
+                reached.add(addr)
+                mnemonic = instructions[addr][0]
+                following = next_address.get(addr)
+                
+                if mnemonic in ('call', 'rcall'):
+                    destination = target(addr)
+                    # rcall .+0 ir steka ietvara rezervēšana, nevis izsaukums
+                    if destination is not None and destination != following:
+                        calls.append(destination)
+                    pending.append(following)
+                elif mnemonic in ('ret', 'reti', 'ijmp', 'eijmp'):
+                    if mnemonic in ('ijmp', 'eijmp'):
+                        logger.warning(f"Indirect jump at 0x{addr:x} cannot be followed")
+                elif mnemonic in ('jmp', 'rjmp'):
+                    destination = target(addr)
+                    # Lēciens uz citas funkcijas sākumu ir astes izsaukums
+                    if destination in function_starts and destination != start:
+                        calls.append(destination)
+                    elif destination is not None and destination != 0:
+                        pending.append(destination)
+                elif mnemonic.startswith('br'):
+                    pending.extend([following, target(addr)])
+                elif mnemonic in ('cpse', 'sbrc', 'sbrs', 'sbic', 'sbis'):
+                    pending.extend([following, next_address.get(following)])
+                else:
+                    pending.append(following)
+            return reached, calls
+        
+        def is_stub(addr):
+            """Noklusējuma pārtraukuma apstrādātājs (__bad_interrupt) ir lēciens uz adresi 0."""
+            return addr in instructions and instructions[addr][0] in ('jmp', 'rjmp') and target(addr) == 0
+        
+        # Reset kods: avr-libc startēšanas kods izsauc main un pēc tā lec uz exit (call main; jmp exit).
+        # Pirms main var būt konstruktoru un inicializācijas izsaukumi, tāpēc pirmais izsaukums der tikai kā rezerve
+        reset = vectors[0]
+        reset_code, _ = explore(reset, set())
+        reset_calls = [addr for addr in sorted(reset_code) if instructions[addr][0] in ('call', 'rcall')]
+        main_address = next(
+            (target(addr) for addr in reset_calls
+             if instructions.get(next_address.get(addr), ("",))[0] in ('jmp', 'rjmp')), None
+        )
+        if main_address is None and reset_calls:
+            main_address = target(reset_calls[0])
+            logger.warning(f"No call followed by a jump to exit in the reset code, assuming main at 0x{main_address:x}")
+        if main_address is None:
+            raise RuntimeError("Could not find the call to main in the reset code")
+        
+        names = {main_address: 'main'}
+        for number, handler in enumerate(vectors[1:], start=1):
+            if handler is not None and handler != reset and handler not in names and not is_stub(handler):
+                names[handler] = f"__vector_{number}"
+        
+        # Rekursīvi atrod izsaukumu mērķus, līdz funkciju kopa vairs nemainās
+        extents = {}
+        while True:
+            extents = {start: explore(start, set(names)) for start in names}
+            discovered = {call for _, calls in extents.values() for call in calls} - set(names)
+            if not discovered:
+                break
+            for start in discovered:
+                names[start] = f"sub_{start:05x}"
+        logger.info(f"Recovered {len(names)} functions from image without symbols")
+        
+        # Pārraksta izsaukumu komentārus ar sintētiskajiem nosaukumiem
+        def symbolic_line(addr):
+            mnemonic, _, _, line = instructions[addr]
+            destination = target(addr) if mnemonic in ('call', 'rcall', 'jmp', 'rjmp') else None
+            if destination in names:
+                return line.split(';', 1)[0].rstrip() + f"\t; 0x{destination:x} <{names[destination]}>"
+            return line
+        
+        output = []
+        for start in sorted(names):
+            output.append("")
+            output.append(f"{start:08x} <{names[start]}>:")
+            output.extend(symbolic_line(addr) for addr in sorted(extents[start][0]))
+        
+        # Steka un kaudzes analīzei nepieciešamais .data/.bss izmērs no startēšanas koda cikliem
+        statics = {'data': 0, 'bss': 0}
+        registers = {}
+        copying = False
+        compare_low = None
+        for addr in sorted(reset_code):
+            mnemonic, operands, _, line = instructions[addr]
+            if mnemonic in ('lpm', 'elpm'):
+                copying = True
+            elif mnemonic == 'cpi' and operands.startswith('r26,'):
+                compare_low = int(operands.split(',')[1], 0)
+            elif mnemonic == 'cpc' and operands.startswith('r27,') and compare_low is not None:
+                high = registers.get(int(operands.split(',')[1].strip()[1:]))
+                start = register_pair_value(registers, 26)
+                if high is not None and start is not None:
+                    end = (high << 8) | compare_low
+                    statics['data' if copying else 'bss'] += max(end - start, 0)
+                copying = False
+                compare_low = None
+                continue
+            track_register_constants(line, registers)
+        if not any(statics.values()):
+            statics = None
+        
+        return "\n".join(output) + "\n", statics
+
     def detect_recursion_from_assembly(self, asm_code, gcc_stack_usage):
         """Enhanced recursion detection with better function name normalization"""
         logger.info("Detecting recursive functions from assembly call patterns")
@@ -257,15 +907,17 @@ class AVRCStackAnalyzer:
         # Funkciju adrešu kartējums
         function_addresses = {}
         func_pattern = re.compile(r'^([0-9a-f]+) <([^>]+)>:')
+        symbol_index = SymbolIndex(gcc_stack_usage)
         
         # Savāc funkciju adreses (baitu adreses)
         for line in asm_code.split('\n'):
             match = func_pattern.match(line)
             if match:
-                addr_str, func_name = match.groups()
+                addr_str, symbol = match.groups()
                 
-                # Pārbauda, vai šī funkcija eksistē mūsu steka izmantojumā
-                if func_name in gcc_stack_usage:
+                # Pārbauda, vai šī funkcija (vai klons) eksistē mūsu steka izmantojumā
+                func_name = symbol_index.resolve(symbol) or symbol_index.node(symbol)
+                if func_name is not None:
                     byte_addr = int(addr_str, 16)
                     word_addr = byte_addr // 2  # AVR izsaukums izmanto vārdu adreses
                     word_addr_hex = f"{word_addr:x}"
@@ -317,9 +969,9 @@ class AVRCStackAnalyzer:
                         logger.debug(f"Identified compiler-generated label: {func_name}")
                     continue
                 
-                if func_name in gcc_stack_usage:
-                    current_function = func_name
-                    in_main_function = (func_name == 'main')
+                if symbol_index.node(func_name) is not None:
+                    current_function = symbol_index.node(func_name)
+                    in_main_function = (current_function == 'main')
                     logger.debug(f"Entering function: {current_function}")
                 continue
             
@@ -501,8 +1153,18 @@ class AVRCStackAnalyzer:
         reduction_info = {}
         
         for func in recursive_functions:
+            # Lietotāja norādītais dziļums (--recursion-limit) aizstāj pirmkoda analīzi
+            if func in self.recursion_overrides:
+                recursion_limits[func] = self.recursion_overrides[func]
+                reduction_info[func] = {"type": "override", "value": 1}
+                logger.info(f"Using recursion limit {recursion_limits[func]} for {func} from --recursion-limit")
+                continue
+
             if not self.source_content:
-                raise RuntimeError(f"Cannot determine recursion depth for function '{func}': Source code not available for analysis")
+                raise RuntimeError(
+                    f"Cannot determine recursion depth for function '{func}': Source code not available for analysis, "
+                    f"use --recursion-limit {func}=N"
+                )
             
             logger.info(f"Analyzing recursion depth for {func}")
             
@@ -574,8 +1236,8 @@ class AVRCStackAnalyzer:
             # Ja rekursijas dziļums nav nosakāms, izmet kļūdu
             if not found_initial_value or initial_value is None:
                 raise RuntimeError(
-                    f"Cannot determine recursion depth for function '{func}':"
-                    f"Unable to find initial parameter value."
+                    f"Cannot determine recursion depth for function '{func}': "
+                    f"Unable to find initial parameter value, use --recursion-limit {func}=N"
                 )
 
             # Nosaka rekursijas tipu balstoties uz funkcijas šablonu
@@ -649,6 +1311,7 @@ class AVRCStackAnalyzer:
         # Funkciju adrešu kartējums - gan baitu, gan vārdu adreses
         function_addresses = {}
         func_pattern = re.compile(r'^([0-9a-f]+) <([^>]+)>:')
+        symbol_index = SymbolIndex(gcc_stack_usage)
         
         # Atrod funkciju adreses
         for line in asm_code.split('\n'):
@@ -659,6 +1322,9 @@ class AVRCStackAnalyzer:
                 # Izlaiž, ja nav mūsu steka izmantojuma ierakstos
                 if func_name.startswith('__') or func_name.startswith('.'):
                     continue
+                
+                # Kloni tiek kartēti uz savu .su ierakstu, nezināmie simboli paliek kā ir
+                func_name = symbol_index.resolve(func_name) or func_name
                     
                 byte_addr = int(addr_str, 16)
                 word_addr = byte_addr // 2  # AVR izsaukums izmanto vārdu adreses
@@ -683,6 +1349,8 @@ class AVRCStackAnalyzer:
         avr_call_pattern = re.compile(r'^\s*([0-9a-f]+):\s+[0-9a-f ]+\s+(?:call|rcall)\s+(?:0x)?([0-9a-f]+)')
         rcall_relative_pattern = re.compile(r'^\s*[0-9a-f]+:\s+[0-9a-f ]+\s+rcall\s+\.([+-]\d+)')
         indirect_call_pattern = re.compile(r'^\s*([0-9a-f]+):\s+[0-9a-f ]+\s+(?:icall|eicall)\s*')
+        # Lēciens uz citas funkcijas sākumu (komentārā simbols bez nobīdes) ir astes izsaukums
+        tail_call_pattern = re.compile(r'^\s*[0-9a-f]+:\s+[0-9a-f ]+\s+(?:jmp|rjmp)\s+[^;]*;\s*0x[0-9a-f]+\s+<([^>+]+)>')
         
         # Z reģistra (r30/r31) izsekošanas šabloni
         ldi_r30_pattern = re.compile(r'^\s*[0-9a-f]+:\s+[0-9a-f ]+\s+ldi\s+r30,\s+(?:lo8\(.*\)|\s*0x)?([0-9a-f]+)(?:\)?)?')
@@ -713,12 +1381,13 @@ class AVRCStackAnalyzer:
                         logger.debug(f"Ignoring compiler-generated label: {func_name}, staying in {current_function}")
                     continue
                 
-                # Pārbauda, vai šī ir funkcija, ko mēs izsekojam
-                if func_name in gcc_stack_usage:
-                    current_function = func_name
+                # Pārbauda, vai šī ir funkcija (vai tās '.cold' daļa vai klons bez .su ieraksta), ko mēs izsekojam
+                if symbol_index.node(func_name) is not None:
+                    current_function = symbol_index.node(func_name)
                     logger.debug(f"Entering function: {current_function} (from {func_name})")
                     
                     # Inicializē izsekošanu šai funkcijai, ja nepieciešams
+                    call_graph.setdefault(current_function, [])
                     if current_function not in r30_values:
                         r30_values[current_function] = None
                         r31_values[current_function] = None
@@ -750,6 +1419,15 @@ class AVRCStackAnalyzer:
                     logger.debug(f"Call to unresolved address {call_addr} in {current_function}")
                 continue
             
+            # Astes izsaukums (jmp/rjmp uz citu funkciju, arī atjaunotajām sub_XXXXX funkcijām)
+            tail_call_match = tail_call_pattern.match(line)
+            if tail_call_match:
+                called_func = symbol_index.node(tail_call_match.group(1))
+                if called_func is not None and called_func != current_function and called_func not in call_graph[current_function]:
+                    call_graph[current_function].append(called_func)
+                    logger.info(f"Found tail call from {current_function} to {called_func}")
+                continue
+            
             # Izseko vērtību ielādi Z reģistrā
             ldi_r30_match = ldi_r30_pattern.search(line)
             if ldi_r30_match:
@@ -778,13 +1456,13 @@ class AVRCStackAnalyzer:
                     logger.debug(f"Found stack frame setup via rcall .+0 in {current_function}")
                     continue
                 
-                # Meklē funkciju nosaukumus tieši assemblera rindā inline assembleram
-                for func_name in gcc_stack_usage.keys():
-                    if func_name in line:
-                        if func_name not in call_graph[current_function]:
-                            call_graph[current_function].append(func_name)
-                            logger.info(f"Found relative rcall from {current_function} to {func_name}")
-                        break
+                # Meklē mērķa simbolu assemblera komentārā (; 0x82 <leaf>)
+                target_match = re.search(r'<([^>+]+)>', line)
+                func_name = symbol_index.node(target_match.group(1)) if target_match else None
+                if func_name is not None:
+                    if func_name not in call_graph[current_function]:
+                        call_graph[current_function].append(func_name)
+                        logger.info(f"Found relative rcall from {current_function} to {func_name}")
                 else:
                     logger.debug(f"Relative call with offset {offset} in {current_function} - target unknown")
                 continue
@@ -909,6 +1587,35 @@ class AVRCStackAnalyzer:
         """Analizē maksimālo steka izmantojumu, balstoties uz disasambleto kodu."""
         logger.info("Static Analysis: Analyzing stack operations...")
         
+        # Rekursija, tās dziļums un izsaukumu grafs
+        call_graph, recursive_functions, recursion_limits, reduction_info = self.analyze_call_structure(asm_code, gcc_stack_usage)
+        
+        # Funkciju steka izmantojums
+        function_stack_usage = self.resolve_function_stack_usage(asm_code, gcc_stack_usage)
+        
+        # Savieno izsaukumu grafu ar funkciju steka izmantojumu
+        complete_call_graph = self.link_call_graph(call_graph, function_stack_usage, gcc_stack_usage, recursive_functions)
+        
+        # Kaudzes alokāciju vietas un izsaukumu vietu skaits starp funkcijām
+        heap_sites = self.collect_heap_sites(asm_code)
+        call_sites = self.count_call_sites(asm_code, gcc_stack_usage)
+        
+        # Pārtraukumu apstrādātāji un to prioritātes līmeņi
+        interrupt_model = self.collect_interrupt_levels(asm_code)
+        
+        return self.solve_stack_usage(
+            function_stack_usage,
+            complete_call_graph,
+            recursive_functions,
+            recursion_limits,
+            reduction_info,
+            heap_sites,
+            interrupt_model,
+            call_sites
+        )
+
+    def analyze_call_structure(self, asm_code, gcc_stack_usage):
+        """Nosaka rekursīvās funkcijas, to dziļumu un izsaukumu grafu."""
         # Rekursijas noteikšana izmantojot bāzes funkciju nosaukumus
         recursive_functions = self.detect_recursion_from_assembly(asm_code, gcc_stack_usage)
         
@@ -918,15 +1625,31 @@ class AVRCStackAnalyzer:
         # Izsaukuma grafa noteikšana
         call_graph = self.build_call_graph(asm_code, gcc_stack_usage)
         
+        return call_graph, recursive_functions, recursion_limits, reduction_info
+
+    def resolve_function_stack_usage(self, asm_code, gcc_stack_usage):
+        """Nosaka katras funkcijas steka izmantojumu no assemblera, vajadzības gadījumā izmantojot GCC vērtības."""
         # Aprēķina steka izmantojumu no assemblera koda
         calculated_stack_usage = self.analyze_function_stack_usage_from_asm(asm_code)
         
+        # Klonu simboli tiek kartēti uz saviem .su ierakstiem ('.cold' daļām sava ietvara nav)
+        symbol_index = SymbolIndex(gcc_stack_usage)
+        for symbol, usage in list(calculated_stack_usage.items()):
+            func_name = symbol_index.resolve(symbol)
+            if func_name is not None and func_name not in calculated_stack_usage:
+                calculated_stack_usage[func_name] = usage
+        
         # Funkciju analīze
         function_stack_usage = {}
         
         for function_name in gcc_stack_usage.keys():
+            # Pārtraukumu apstrādātāju ietvari nāk no .su; dekodētā vērtība tiek izmantota tikai
+            # attēliem bez .su datiem (tur visas GCC vērtības ir 0)
+            if re.fullmatch(r'__vector_\d+', function_name) and gcc_stack_usage[function_name] > 0:
+                function_stack_usage[function_name] = gcc_stack_usage[function_name]
+                logger.debug(f"Interrupt handler {function_name}: using GCC value {gcc_stack_usage[function_name]} bytes")
             # Ja funkcijas ir aprēķinātas no assemblera, izmanto tās
-            if function_name in calculated_stack_usage:
+            elif function_name in calculated_stack_usage:
                 function_stack_usage[function_name] = calculated_stack_usage[function_name]
                 logger.debug(f"Function {function_name}: using calculated value {calculated_stack_usage[function_name]} bytes")
             else:
@@ -941,27 +1664,44 @@ class AVRCStackAnalyzer:
                         f"Function not found in calculated stack usage or GCC stack usage reports. "
                     )
         
+        # Klonam bez sava .su ieraksta (piem., otrais .isra klons) ietvars var atšķirties no
+        # izcelsmes funkcijas, tāpēc tiek izmantota no assemblera aprēķinātā vērtība
+        for symbol, usage in calculated_stack_usage.items():
+            if symbol not in function_stack_usage and symbol_index.owner(symbol) is None and symbol_index.origin(symbol) is not None:
+                function_stack_usage[symbol] = usage
+                logger.debug(f"Clone {symbol} has no .su entry: using calculated value {usage} bytes")
+        
+        return function_stack_usage
+
+    def link_call_graph(self, call_graph, function_stack_usage, gcc_stack_usage, recursive_functions):
+        """
+        Papildina function_stack_usage ar assemblera funkcijām un pievieno rekursīvos pašizsaukumus.
+        Atgriež pilnu izsaukumu grafu.
+        """
         # Pievieno mapping starp assemblera un GCC funkciju nosaukumiem
         asm_to_gcc_mapping = {}
+        symbol_index = SymbolIndex(gcc_stack_usage)
         
         # Apkopo visas assemblera funkcijas no call_graph (gan keys, gan values)
         all_asm_functions = set(call_graph.keys())
         for callees in call_graph.values():
             all_asm_functions.update(callees)
 
-        # Meklē mappings
+        # Meklē mappings: klona paša .su ieraksts, citādi izcelsmes funkcijas ieraksts
         for asm_func in all_asm_functions:
-            for gcc_func in gcc_stack_usage.keys():
-                # Ja assemblera funkcija sākas ar GCC funkcijas nosaukumu
-                if asm_func.startswith(gcc_func):
-                    asm_to_gcc_mapping[asm_func] = gcc_func
-                    break
+            gcc_func = symbol_index.resolve(asm_func) or symbol_index.origin(asm_func)
+            if gcc_func is not None:
+                asm_to_gcc_mapping[asm_func] = gcc_func
 
         # Papildina function_stack_usage ar assemblera funkcijām
         for asm_func, gcc_func in asm_to_gcc_mapping.items():
             if asm_func not in function_stack_usage:
                 function_stack_usage[asm_func] = gcc_stack_usage[gcc_func]
-                logger.debug(f"Mapped {asm_func} -> {gcc_func}: {gcc_stack_usage[gcc_func]} bytes")
+                if symbol_index.resolve(asm_func) is None:
+                    logger.warning(f"Clone '{asm_func}' has no stack usage of its own, assuming the frame of "
+                                   f"'{gcc_func}' ({gcc_stack_usage[gcc_func]} bytes); clones may use a different frame")
+                else:
+                    logger.debug(f"Mapped {asm_func} -> {gcc_func}: {gcc_stack_usage[gcc_func]} bytes")
 
         # Pievieno rekursīvos pašizsaukumus izsaukumu grafam
         for func in recursive_functions:
@@ -972,8 +1712,11 @@ class AVRCStackAnalyzer:
                 logger.info(f"Added self-call for recursive function {func}")
         
         # Izveido pilnu izsaukumu grafu
-        complete_call_graph = {func: callees.copy() for func, callees in call_graph.items()}
-        
+        return {func: callees.copy() for func, callees in call_graph.items()}
+
+    def solve_stack_usage(self, function_stack_usage, complete_call_graph, recursive_functions, recursion_limits, reduction_info,
+                          heap_sites=None, interrupt_model=None, call_sites=None):
+        """Aprēķina maksimālo steka izmantojumu un sagatavo analīzes rezultātus."""
         logger.info(f"Detected recursive functions: {recursive_functions}")
         logger.info(f"Recursion limits: {recursion_limits}")
         logger.info(f"Final call graph: {complete_call_graph}")
@@ -986,6 +1729,15 @@ class AVRCStackAnalyzer:
             recursion_limits
         )
         
+        # Pārtraukumi tiek pieskaitīti main ceļam saskaņā ar ligzdošanas modeli
+        interrupts = None
+        if interrupt_model and interrupt_model['vectors']:
+            interrupts = self.calculate_interrupt_stack(
+                interrupt_model, max_stack_usage, complete_call_graph, function_stack_usage,
+                recursive_functions, recursion_limits
+            )
+            max_stack_usage += interrupts['interrupt_usage']
+        
         # Pievieno drošības rezervi 10%
         safe_max_stack_usage = int(max_stack_usage * 1.10)
         
@@ -997,9 +1749,17 @@ class AVRCStackAnalyzer:
             'recursive_functions': list(recursive_functions),
             'recursion_limits': recursion_limits,
             'reduction_info': dict(reduction_info),
-            'all_paths': all_complete_paths
+            'all_paths': all_complete_paths,
+            'heap': None,
+            'interrupts': interrupts
         }
         
+        # Kaudzes robeža, ja programmā ir alokācijas izsaukumi
+        if heap_sites:
+            analysis_results['heap'] = self.calculate_heap_bound(
+                heap_sites, complete_call_graph, recursive_functions, recursion_limits, call_sites
+            )
+        
         return analysis_results
 
     def analyze_function_stack_usage_from_asm(self, asm_code):
@@ -1009,12 +1769,19 @@ class AVRCStackAnalyzer:
         """
         function_stack_usage = {}
         
+        # Katrs izsaukums (arī rcall .+0) stekā ieraksta atgriešanās adresi: 2 vai 3 baiti
+        return_addr_size = self.return_address_size()
+        
         # Funkciju meklēšanas šablons assemblera izdrukā
         func_pattern = re.compile(r'^([0-9a-f]+) <([^>]+)>:')
         
         # Y reģistra steka rāmja šabloni
         sbiw_pattern = re.compile(r'^\s*[0-9a-f]+:\s+[0-9a-f ]+\s+sbiw\s+r28,\s+0x([0-9a-f]+)')
         adiw_pattern = re.compile(r'^\s*[0-9a-f]+:\s+[0-9a-f ]+\s+adiw\s+r28,\s+0x([0-9a-f]+)')
+        # Rāmji virs 63 baitiem: Y = SP; subi r28, lo8(N); sbci r29, hi8(N); SP = Y
+        y_from_sp_pattern = re.compile(r'^\s*[0-9a-f]+:\s+[0-9a-f ]+\s+in\s+r28,\s*0x3d')
+        subi_pattern = re.compile(r'^\s*[0-9a-f]+:\s+[0-9a-f ]+\s+subi\s+r28,\s*0x([0-9a-fA-F]+)')
+        sbci_pattern = re.compile(r'^\s*[0-9a-f]+:\s+[0-9a-f ]+\s+sbci\s+r29,\s*0x([0-9a-fA-F]+)')
         
         # SPL/SPH tiešās manipulācijas šabloni
         spl_in_pattern = re.compile(r'^\s*[0-9a-f]+:\s+[0-9a-f ]+\s+in\s+r\d+,\s*0x3d')
@@ -1076,8 +1843,8 @@ class AVRCStackAnalyzer:
         # Analizē katru funkciju
         for func_name, func_info in functions.items():
             
-            # Izlaiž sistēmas/kompilatora ģenerētās funkcijas
-            if func_name.startswith('__') or func_name in ('__ctors_end', '__bad_interrupt', '_exit', '__stop_program'):
+            # Izlaiž sistēmas/kompilatora ģenerētās funkcijas (pārtraukumu apstrādātāji tiek analizēti)
+            if func_name.startswith('__') and not re.fullmatch(r'__vector_\d+', func_name) or func_name in ('__ctors_end', '__bad_interrupt', '_exit', '__stop_program'):
                 continue
             
             # Funkcijas assemblera kods
@@ -1098,8 +1865,31 @@ class AVRCStackAnalyzer:
             spl_manipulations = 0
             sph_manipulations = 0
             
+            # subi/sbci rāmis tiek skaitīts tikai starp "in r28, 0x3d" un SP ierakstu,
+            # lai epiloga subi ar negatīvu vērtību (rāmja atbrīvošana) netiktu pieskaitīts
+            y_from_sp = False
+            frame_low = frame_high = None
+            
             # Pilna funkcijas analīze
             for line in func_lines:
+                if y_from_sp_pattern.search(line):
+                    y_from_sp = True
+                    frame_low = frame_high = None
+                elif y_from_sp:
+                    subi_match = subi_pattern.search(line)
+                    sbci_match = sbci_pattern.search(line)
+                    if subi_match and frame_low is None:
+                        frame_low = int(subi_match.group(1), 16)
+                    elif sbci_match and frame_low is not None and frame_high is None:
+                        frame_high = int(sbci_match.group(1), 16)
+                    elif spl_out_pattern.search(line) or sph_out_pattern.search(line):
+                        if frame_low is not None:
+                            stack_adjust_down += frame_low | ((frame_high or 0) << 8)
+                            logger.debug(f"Found subi/sbci stack frame in {func_name}: "
+                                         f"{frame_low | ((frame_high or 0) << 8)} bytes")
+                        y_from_sp = False
+                        frame_low = frame_high = None
+                
                 # Atrod PUSH instrukcijas (palielina steku)
                 if "push" in line and "r" in line:
                     push_count += 1
@@ -1139,9 +1929,9 @@ class AVRCStackAnalyzer:
                     if rel_match:
                         offset = rel_match.group(1)
                         if offset == "+0":
-                            # rcall .+0 rezervē 2 baitus stekā
-                            stack_adjust_down += 2  
-                            logger.debug(f"Found rcall .+0 pattern, adding 2 bytes to stack")
+                            # rcall .+0 rezervē atgriešanās adreses izmēru stekā
+                            stack_adjust_down += return_addr_size
+                            logger.debug(f"Found rcall .+0 pattern, adding {return_addr_size} bytes to stack")
                         else:
                             # Parasts rcall ar nobīdi - funkcijas izsaukums
                             rcall_count += 1
@@ -1163,10 +1953,6 @@ class AVRCStackAnalyzer:
             if stack_adjust_down != stack_adjust_up:
                 logger.debug(f"Function {func_name} has unbalanced stack adjustments: down {stack_adjust_down}, up {stack_adjust_up}")
                                 
-            # Steka izmantojums funkcijas izsaukumiem (CALL, RCALL, ICALL)
-            # Katrs izsaukums aizņem 2 baitus atgriešanās adresei
-            return_addr_size = 2  # AVR atgriešanās adrese ir 2 baiti
-            
             # Kopējais maksimālais steka izmantojums
             # PUSH instrukcijas + steka rāmis + atgriešanās adrese 
             # (POP un ADIW mūs neinteresē, jo tie tikai samazina steku)
@@ -1435,80 +2221,1139 @@ class AVRCStackAnalyzer:
         max_path, _ = find_max_branch(start_func)
         return max_path
 
-    def get_memory_sections(self):
-        """Iegūst .data un .bss sekciju izmērus no ELF faila"""
-        result = subprocess.run(
-            ["avr-size", self.elf_file],
-            capture_output=True, text=True
-        )
-        # Parsē izvadi: "text    data     bss"
-        lines = result.stdout.strip().split('\n')
-        if len(lines) >= 2:
-            sizes = lines[1].split()
-            return {
-                'data': int(sizes[1]),
-                'bss': int(sizes[2])
-            }
-        return {'data': 0, 'bss': 0}
-    
-    def generate_report(self, static_analysis):
-        """Ģenerē visaptverošu pārskatu par steka izmantojuma analīzi."""
-        sections = self.get_memory_sections()
-        data_size = sections.get('data', 0) + sections.get('bss', 0)
-        available_stack = self.ram_size - data_size
+    def collect_function_origins(self):
+        """
+        Nosaka katras funkcijas izcelsmi (direktorija, bibliotēka, fails) no .su failiem
+        un linkera kartes. Atgriež {funkcija: (direktorija, bibliotēka, fails)}.
+        """
+        origins = {}
+        
+        # Linkera karte satur ievades sekcijas ar objekta failu un tajās definētos simbolus
+        if self.map_file and os.path.exists(self.map_file):
+            section_pattern = re.compile(r'^\s\.text\S*(?:\s+0x[0-9a-f]+\s+0x[0-9a-f]+\s+(\S+))?$')
+            continuation_pattern = re.compile(r'^\s+0x[0-9a-f]+\s+0x[0-9a-f]+\s+(\S+)$')
+            symbol_pattern = re.compile(r'^\s+0x[0-9a-f]+\s+([A-Za-z_][\w.]*)$')
+            archive_pattern = re.compile(r'^(.*\.a)\((.+)\)$')
+            
+            in_memory_map = False
+            pending_section = False
+            current_object = None
+            
+            with open(self.map_file, 'r') as f:
+                for line in f:
+                    line = line.rstrip('\n')
+                    if line.startswith("Linker script and memory map"):
+                        in_memory_map = True
+                        continue
+                    if not in_memory_map:
+                        continue
+                    
+                    section_match = section_pattern.match(line)
+                    if section_match:
+                        # Garš sekcijas nosaukums - objekta fails ir nākamajā rindā
+                        current_object = section_match.group(1)
+                        pending_section = current_object is None
+                        continue
+                    
+                    if pending_section:
+                        continuation_match = continuation_pattern.match(line)
+                        current_object = continuation_match.group(1) if continuation_match else None
+                        pending_section = False
+                        continue
+                    
+                    # Jebkura cita sekcija (ne .text) pārtrauc simbolu piesaisti
+                    if line.startswith(' .') or line.startswith('.'):
+                        current_object = None
+                        continue
+                    
+                    symbol_match = symbol_pattern.match(line)
+                    if symbol_match and current_object:
+                        archive_match = archive_pattern.match(current_object)
+                        if archive_match:
+                            archive, member = archive_match.groups()
+                            origin = (os.path.dirname(archive) or '.', os.path.basename(archive), member)
+                        else:
+                            origin = (os.path.dirname(current_object) or '.', '', os.path.basename(current_object))
+                        origins[symbol_match.group(1)] = origin
+        else:
+            logger.debug("Linker map not available, function origins taken from .su files only")
+        
+        # .su faili norāda precīzu avota failu lietotāja funkcijām (kompilators saņem absolūtu ceļu,
+        # atskaitē tas tiek rādīts relatīvi pret darba direktoriju)
+        for func_name, su_path in self.stack_usage_files.items():
+            if os.path.isabs(su_path):
+                su_path = os.path.relpath(su_path)
+            origins[func_name] = (os.path.dirname(su_path) or '.', '', os.path.basename(su_path))
+        
+        return origins
+
+    def find_worst_chain(self, start_func, call_graph, function_stack_usage, recursive_functions, recursion_limits):
+        """
+        Atrod sliktākā gadījuma izsaukumu ķēdi ar dinamisko programmēšanu, neuzskaitot visus ceļus.
+        Rekursīvās funkcijas tiek apstrādātas tāpat kā calculate_max_stack_usage (lokālais * dziļums).
+        Atgriež (kopējais izmantojums, [(funkcija, atkārtojumu skaits), ...]).
+        """
+        best = {}
+        on_stack = set()
+        # Cikla funkcijas rezultāts ir atkarīgs no tā, kuras cikla funkcijas jau ir ceļā, tāpēc tas
+        # tiek kešots un izmantots tikai tad, kad neviena tās komponentes funkcija nav ceļā
+        component = call_graph_components(call_graph)
+        active = Counter()
+        
+        def solve(func_name):
+            """Atgriež (izmantojums, ķēde) no func_name uz leju."""
+            if func_name in on_stack:
+                # Nerekursīvs cikls
+                return 0, ()
+            open_cycle = active[component.get(func_name)] > 0
+            if func_name in best and not open_cycle:
+                return best[func_name]
+            if func_name not in function_stack_usage:
+                # Nezināma funkcija
+                return 0, ()
+            
+            if func_name in recursive_functions:
+                depth = recursion_limits.get(func_name, 1)
+                best[func_name] = (function_stack_usage[func_name] * depth, ((func_name, depth),))
+                return best[func_name]
+            
+            on_stack.add(func_name)
+            active[component.get(func_name)] += 1
+            best_child_usage, best_child_chain = 0, ()
+            for called_func in call_graph.get(func_name, []):
+                called_usage, called_chain = solve(called_func)
+                if called_usage > best_child_usage:
+                    best_child_usage, best_child_chain = called_usage, called_chain
+            active[component.get(func_name)] -= 1
+            on_stack.discard(func_name)
+            
+            result = (function_stack_usage[func_name] + best_child_usage, ((func_name, 1),) + best_child_chain)
+            if not open_cycle:
+                best[func_name] = result
+            return result
+        
+        total, chain = solve(start_func)
+        return total, list(chain)
+
+    def worst_case_chains(self, static_analysis):
+        """
+        Atgriež izsaukumu ķēdes, kas kopā veido sliktāko gadījumu (raw_max_usage): main ķēdi un
+        pārtraukumu ķēdes, kas tai pieskaitītas saskaņā ar ligzdošanas modeli.
+        Atgriež (kopējais izmantojums, [ķēde, ...]).
+        """
+        roots = ['main']
+        if static_analysis.get('interrupts'):
+            roots += [vector for _, vector, _ in static_analysis['interrupts']['levels']]
+        
+        total = 0
+        chains = []
+        for root in roots:
+            usage, chain = self.find_worst_chain(
+                root,
+                static_analysis['call_graph'],
+                static_analysis['function_usage'],
+                set(static_analysis['recursive_functions']),
+                static_analysis['recursion_limits']
+            )
+            total += usage
+            chains.append(chain)
+        return total, chains
+
+    def generate_module_breakdown(self, static_analysis, function_origins):
+        """Ģenerē steka izmantojuma sadalījumu pa direktorijām, bibliotēkām un avota failiem."""
+        function_usage = static_analysis['function_usage']
+        
+        # Sliktākais gadījums: main ķēde un pieskaitītās pārtraukumu ķēdes
+        total, chains = self.worst_case_chains(static_analysis)
+        worst_contribution = {}
+        for chain in chains:
+            for func_name, multiplicity in chain:
+                worst_contribution[func_name] = worst_contribution.get(func_name, 0) + function_usage[func_name] * multiplicity
+        
+        # Koks: direktorija -> bibliotēka -> fails -> funkcijas
+        # Katram mezglam: [sliktākā ceļa daļa, ietvaru summa, apakšmezgli]
+        tree = {}
+        for func_name, usage in function_usage.items():
+            directory, library, file_name = function_origins.get(func_name, ('(unknown)', '', '(unknown)'))
+            path = (directory, library or '(no library)', file_name)
+            level = tree
+            for part in path:
+                node = level.setdefault(part, [0, 0, {}])
+                node[0] += worst_contribution.get(func_name, 0)
+                node[1] += usage
+                level = node[2]
+            level[func_name] = [worst_contribution.get(func_name, 0), usage, {}]
         
-        # Teksta atskaite
         report = [
-            f"Stack Analysis Report for {os.path.basename(self.source_file)}",
-            "=" * 60,
-            f"MCU Type: {self.mcu_type}",
-            f"RAM Size: {self.ram_size} bytes",
-            f"Data Size (.data + .bss): {data_size} bytes",
-            f"Available Stack Space: {available_stack} bytes",
-            "",
-            "Static Analysis Results:",
-            "-" * 30,
-            f"Maximum Stack Usage (with 10% safety margin): {static_analysis['max_stack_usage']} bytes",
-            f"Calculated Stack Usage: {static_analysis['raw_max_usage']} bytes",
-            f"Free Stack Space: {int(available_stack - static_analysis['max_stack_usage'])} bytes",
-            f"Stack Usage Percentage: {(static_analysis['max_stack_usage'] / self.ram_size * 100):.1f}%",
             "",
-            "Function Stack Usage (includes 2 bytes return addr):",
+            "Stack Breakdown by Module (worst case incl. interrupts / frame total):",
             "-" * 30,
         ]
         
-        # Kārto funkcijas pēc steka lietojuma (dilstošā secībā)
-        sorted_functions = sorted(
-            static_analysis['function_usage'].items(),
-            key=lambda x: x[1],
-            reverse=True
-        )
+        def add_nodes(level, depth):
+            # Kārto pēc ieguldījuma sliktākajā ceļā, tad pēc ietvaru summas
+            for name, (worst, frames, children) in sorted(level.items(), key=lambda item: (item[1][0], item[1][1]), reverse=True):
+                share = (worst / total * 100) if total else 0.0
+                report.append(f"{'  ' * depth}{name}: {worst} / {frames} bytes ({share:.1f}% of worst path)")
+                add_nodes(children, depth + 1)
         
-        # Pievieno informāciju par funkcijām
-        for function, usage in sorted_functions:
-            report.append(f"{function}: {usage} bytes")
-            
-        # Pievieno rekursīvo funkciju informāciju, ja tāda ir
-        if static_analysis['recursive_functions']:
-            report.append("")
-            report.append("Recursive Functions (detected from assembly):")
-            report.append("-" * 30)
-            for func in static_analysis['recursive_functions']:
-                limit = static_analysis['recursion_limits'].get(func, "unknown")
-                reduce_info = static_analysis['reduction_info'].get(func, {})
+        add_nodes(tree, 0)
+        return report
 
-                # Formatē rekursijas veidu ar faktoru
-                recursion_type = reduce_info.get('type', 'unknown')
-                factor = reduce_info.get('value', 1)
+    def collect_heap_sites(self, asm_code):
+        """
+        Atrod malloc/calloc/realloc izsaukumu vietas un nosaka pieprasīto izmēru no konstantēm,
+        kas taisnā kodā (bez lēcienu mērķiem un izsaukumiem starp tām) ielādētas argumentu reģistros.
+        Alokācija ir īslaicīga, ja tās rādītājs tajā pašā funkcijā tiek nodots free (vai realloc),
+        vai ja funkcija anotēta ar @heap-transient; citādi tā ir pastāvīga.
+        Atgriež {funkcija: {'allocations': [(veids, izmērs vai None, adrese, avots, īslaicīga, ciklā)],
+                            'count': izpildes reizes no @heap-count vai None}}.
+        """
+        functions, labels = split_functions(asm_code)
+        allocator_call_pattern = re.compile(r';\s*0x[0-9a-f]+\s+<(malloc|calloc|realloc|free)>')
+        y_slot_pattern = re.compile(r'Y(?:\+(\d+))?$')
+        
+        heap_sites = {}
+        for func_name, instructions in functions.items():
+            # Alokatora iekšējie izsaukumi (piem., calloc -> malloc) netiek uzskaitīti
+            if func_name in ALLOCATOR_FUNCTIONS or func_name.startswith('__') and not func_name.startswith('__vector_'):
+                continue
+            if not any(allocator_call_pattern.search(line) for _, _, _, line in instructions):
+                continue
+            
+            joins, loops = control_flow(instructions, labels)
+            # Y+q steka rāmja šūnas tiek izsekotas tikai funkcijām ar Y rāmi (in r28, 0x3d)
+            has_frame = any(mnemonic == 'in' and operands[:2] == ['r28', '0x3d'] for _, mnemonic, operands, _ in instructions)
+            slot_writes = Counter(
+                operands[0] for _, mnemonic, operands, _ in instructions
+                if mnemonic in ('st', 'std') and operands and y_slot_pattern.match(operands[0])
+            )
+            
+            allocations = []
+            registers = {}   # Zināmās konstantes
+            pointers = {}    # Reģistrs -> (alokācijas indekss, baits), rādītāji no alokatora
+            slots = {}       # Y+q šūna -> (alokācijas indekss, baits)
+            for address, mnemonic, operands, line in instructions:
+                if address in joins:
+                    # Vairāki ceļi: reģistru vērtības nav zināmas; vienreiz rakstīta šūna saglabā vērtību
+                    registers = {}
+                    pointers = {}
+                    slots = {slot: token for slot, token in slots.items() if slot_writes[slot] == 1}
                 
-                if recursion_type == 'subtraction':
-                    type_str = f"subtraction by {factor}"
-                elif recursion_type == 'division':
-                    type_str = f"division by {factor}"
-                else:
-                    type_str = recursion_type
+                call_match = allocator_call_pattern.search(line) if mnemonic in ('call', 'rcall') else None
+                if call_match:
+                    kind = call_match.group(1)
+                    if kind in ('free', 'realloc'):
+                        # Atbrīvotais (vai pārvietotais) bloks ir īslaicīgs
+                        low, high = pointers.get(24), pointers.get(25)
+                        if low is not None and high is not None and low == (high[0], 0) and high[1] == 1:
+                            allocations[low[0]][4] = True
+                    if kind != 'free':
+                        if kind == 'malloc':
+                            size = register_pair_value(registers, 24)
+                        elif kind == 'calloc':
+                            count = register_pair_value(registers, 24)
+                            element = register_pair_value(registers, 22)
+                            size = count * element if count is not None and element is not None else None
+                        else:
+                            size = register_pair_value(registers, 22)
+                        looped = in_loop(address, loops)
+                        allocations.append([kind, size, f"{address:x}", 'constant' if size is not None else 'unresolved', False, looped])
+                        logger.info(f"Found {kind} call in {func_name} at 0x{address:x}, size: "
+                                    f"{size if size is not None else 'unknown'}{' (in a loop)' if looped else ''}")
+                    track_register_constants(line, registers)
+                    for register in CALL_CLOBBERED_REGISTERS:
+                        pointers.pop(register, None)
+                    if kind != 'free':
+                        pointers[24], pointers[25] = (len(allocations) - 1, 0), (len(allocations) - 1, 1)
+                    continue
                 
-                report.append(f"{func} (recursion limit: {limit}, type: {type_str})")
+                # Rādītāju izsekošana caur reģistriem un Y+q steka rāmja šūnām
+                dest = int(operands[0][1:]) if operands and re.fullmatch(r'r\d+', operands[0]) else None
+                source = int(operands[1][1:]) if len(operands) > 1 and re.fullmatch(r'r\d+', operands[1]) else None
+                if is_call(mnemonic, operands):
+                    for register in CALL_CLOBBERED_REGISTERS:
+                        pointers.pop(register, None)
+                elif mnemonic == 'movw' and dest is not None and source is not None:
+                    for offset in (0, 1):
+                        if pointers.get(source + offset) is not None:
+                            pointers[dest + offset] = pointers[source + offset]
+                        else:
+                            pointers.pop(dest + offset, None)
+                elif mnemonic == 'mov' and dest is not None and source is not None:
+                    if pointers.get(source) is not None:
+                        pointers[dest] = pointers[source]
+                    else:
+                        pointers.pop(dest, None)
+                elif mnemonic in ('st', 'std') and operands and y_slot_pattern.match(operands[0]) and has_frame:
+                    if source is not None and pointers.get(source) is not None:
+                        slots[operands[0]] = pointers[source]
+                    else:
+                        slots.pop(operands[0], None)
+                elif mnemonic in ('ld', 'ldd') and dest is not None and len(operands) > 1 and y_slot_pattern.match(operands[1]) and has_frame:
+                    if slots.get(operands[1]) is not None:
+                        pointers[dest] = slots[operands[1]]
+                    else:
+                        pointers.pop(dest, None)
+                elif dest is not None and mnemonic not in NON_WRITING_INSTRUCTIONS:
+                    pointers.pop(dest, None)
+                    if mnemonic in ('adiw', 'sbiw', 'movw'):
+                        pointers.pop(dest + 1, None)
+                
+                track_register_constants(line, registers)
+            
+            if allocations:
+                heap_sites[func_name] = {'allocations': allocations, 'count': None}
+        
+        # Anotācijas avota kodā:
+        #   // @heap <funkcija> <baiti>         - katras neatrisinātās alokācijas izmērs funkcijā
+        #   // @heap-transient <funkcija>       - funkcijas alokācijas tiek atbrīvotas pirms tā atgriežas
+        #   // @heap-count <funkcija> <reizes>  - cik reizes kopā izpildās katra funkcijas alokācija
+        #                                         (alokācijām ciklā vai rekursijā)
+        def annotated(func_name):
+            return [info for name, info in heap_sites.items() if name == func_name or parse_clone_name(name)[0] == func_name]
+        
+        for match in re.finditer(r'@heap\s+([A-Za-z_]\w*)\s+(\d+)', self.source_content):
+            for info in annotated(match.group(1)):
+                for allocation in info['allocations']:
+                    if allocation[1] is None:
+                        allocation[1], allocation[3] = int(match.group(2)), 'annotation'
+        for match in re.finditer(r'@heap-transient\s+([A-Za-z_]\w*)', self.source_content):
+            for info in annotated(match.group(1)):
+                for allocation in info['allocations']:
+                    allocation[4] = True
+        for match in re.finditer(r'@heap-count\s+([A-Za-z_]\w*)\s+(\d+)', self.source_content):
+            for info in annotated(match.group(1)):
+                info['count'] = int(match.group(2))
+        
+        for info in heap_sites.values():
+            info['allocations'] = [tuple(allocation) for allocation in info['allocations']]
+        return heap_sites
+
+    def count_call_sites(self, asm_code, gcc_stack_usage):
+        """
+        Saskaita tiešo izsaukumu vietas starp funkcijām: {izsaucējs: {izsauktā funkcija: skaits}}.
+        Izsaukums cikla iekšienē var izpildīties neierobežotu reižu skaitu (skaits None).
+        """
+        functions, labels = split_functions(asm_code)
+        symbol_index = SymbolIndex(gcc_stack_usage)
+        target_pattern = re.compile(r';\s*0x[0-9a-f]+\s+<([^>+]+)>')
+        
+        call_sites = {}
+        for func_name, instructions in functions.items():
+            caller = symbol_index.node(func_name) or func_name
+            _, loops = control_flow(instructions, labels)
+            for address, mnemonic, operands, line in instructions:
+                target = target_pattern.search(line)
+                if not target:
+                    continue
+                if mnemonic in ('jmp', 'rjmp'):
+                    # Astes izsaukums uz citu funkciju
+                    callee = symbol_index.node(target.group(1))
+                    if callee is None or callee == caller:
+                        continue
+                elif mnemonic in ('call', 'rcall') and is_call(mnemonic, operands):
+                    callee = symbol_index.resolve(target.group(1)) or target.group(1)
+                else:
+                    continue
+                counts = call_sites.setdefault(caller, {})
+                if in_loop(address, loops) or counts.get(callee, 0) is None:
+                    counts[callee] = None
+                else:
+                    counts[callee] = counts.get(callee, 0) + 1
+        return call_sites
+
+    def calculate_heap_bound(self, heap_sites, call_graph, recursive_functions, recursion_limits, call_sites=None):
+        """
+        Aprēķina dzīvo kaudzes alokāciju augšējo robežu katrai saknei (main un pārtraukumu apstrādātāji).
+        Pastāvīgās alokācijas tiek reizinātas ar to, cik reizes funkcija tiek izsaukta no saknes
+        (izsaukumu vietu skaits pa visiem ceļiem), īslaicīgās tiek skaitītas tikai pa sliktāko ceļu
+        (rekursīvās funkcijas - rekursijas dziļuma reizes). Pastāvīgās alokācijas ciklā vai rekursijā
+        un alokācijas ar nezināmu izmēru bez anotācijas padara robežu nezināmu ('bound' ir None);
+        'lower_bound' ir zināmo alokāciju summa.
+        """
+        call_sites = call_sites or {}
+        margin_match = re.search(r'__malloc_margin\s*=\s*(\d+)', self.source_content)
+        malloc_margin = int(margin_match.group(1)) if margin_match else DEFAULT_MALLOC_MARGIN
+        
+        def chunk_size(size):
+            # avr-libc: minimālais bloks un 2 baitu izmēra galvene katram blokam
+            return max(size, MALLOC_MIN_CHUNK) + MALLOC_HEADER_SIZE
+        
+        def multiplicity(func_name):
+            return recursion_limits.get(func_name, 1) if func_name in recursive_functions else 1
+        
+        unresolved = []
+        
+        def transient_size(func_name):
+            info = heap_sites.get(func_name)
+            if not info:
+                return 0
+            total = 0
+            for kind, size, addr, _, transient, _ in info['allocations']:
+                if not transient:
+                    continue
+                if size is None:
+                    unresolved.append(f"{func_name} ({kind} at 0x{addr}: unknown size)")
+                else:
+                    total += chunk_size(size)
+            return total * multiplicity(func_name)
+        
+        def persistent_size(func_name, calls):
+            """Pastāvīgās alokācijas funkcijā, kas no saknes tiek izsaukta calls reizes (None - neierobežoti)."""
+            info = heap_sites.get(func_name)
+            if not info:
+                return 0
+            total = 0
+            for kind, size, addr, _, transient, looped in info['allocations']:
+                if transient:
+                    continue
+                executions = info['count']
+                if executions is None:
+                    if looped:
+                        unresolved.append(f"{func_name} ({kind} at 0x{addr}: in a loop)")
+                        continue
+                    if calls is None:
+                        unresolved.append(f"{func_name} ({kind} at 0x{addr}: called in a loop or recursion)")
+                        continue
+                    executions = calls
+                if size is None:
+                    unresolved.append(f"{func_name} ({kind} at 0x{addr}: unknown size)")
+                    continue
+                total += chunk_size(size) * executions
+            return total
+        
+        def call_counts(root):
+            """
+            Cik reizes katra sasniedzamā funkcija tiek izsaukta vienā saknes izpildē (topoloģiskā secībā,
+            izsaukumu vietu skaits reizināts pa ceļiem). Cikli, rekursija un to pēcteči: None.
+            """
+            reachable = set()
+            pending = [root]
+            while pending:
+                func_name = pending.pop()
+                if func_name not in reachable:
+                    reachable.add(func_name)
+                    pending.extend(call_graph.get(func_name, []))
+            
+            incoming = Counter(callee for func_name in reachable for callee in set(call_graph.get(func_name, [])))
+            counts = {func_name: 0 for func_name in reachable}
+            counts[root] = 1
+            ready = [func_name for func_name in reachable if incoming[func_name] == 0]
+            done = set()
+            while ready:
+                func_name = ready.pop()
+                done.add(func_name)
+                for callee in set(call_graph.get(func_name, [])):
+                    sites = call_sites.get(func_name, {}).get(callee, 1)
+                    if counts[func_name] is None or sites is None or counts[callee] is None:
+                        counts[callee] = None
+                    else:
+                        counts[callee] += counts[func_name] * sites
+                    incoming[callee] -= 1
+                    if incoming[callee] == 0:
+                        ready.append(callee)
+            for func_name in reachable - done:
+                counts[func_name] = None
+            return counts
+        
+        transient_peak = {}
+        # Tāpat kā find_worst_chain: cikla funkcijas rezultāts tiek kešots tikai, ja neviena
+        # tās komponentes funkcija nav ceļā
+        component = call_graph_components(call_graph)
+        active = Counter()
+        
+        def peak(func_name, on_stack):
+            if func_name in on_stack:
+                return 0
+            open_cycle = active[component.get(func_name)] > 0
+            if func_name in transient_peak and not open_cycle:
+                return transient_peak[func_name]
+            on_stack.add(func_name)
+            active[component.get(func_name)] += 1
+            callee_peak = max((peak(callee, on_stack) for callee in call_graph.get(func_name, []) if callee != func_name), default=0)
+            active[component.get(func_name)] -= 1
+            on_stack.discard(func_name)
+            value = transient_size(func_name) + callee_peak
+            if not open_cycle:
+                transient_peak[func_name] = value
+            return value
+        
+        roots = ['main'] + sorted(func for func in call_graph if func.startswith('__vector_'))
+        root_bounds = []
+        for root in roots:
+            if root not in call_graph:
+                continue
+            counts = call_counts(root)
+            persistent = sum(persistent_size(func_name, calls) for func_name, calls in counts.items())
+            transient = peak(root, set())
+            if persistent or transient or any(func_name in heap_sites for func_name in counts):
+                root_bounds.append((root, persistent, transient, persistent + transient))
+        
+        sites = tuple(
+            (func_name, kind, size, source, 'transient' if transient else 'persistent', looped)
+            for func_name, info in heap_sites.items()
+            for kind, size, _, source, transient, looped in info['allocations']
+        )
+        lower_bound = sum(bound for _, _, _, bound in root_bounds)
+        unresolved = tuple(dict.fromkeys(unresolved))
+        
+        return {
+            'sites': sites,
+            'unresolved': unresolved,
+            'roots': tuple(root_bounds),
+            # Konservatīvi: pārtraukumu alokācijas var pārklāties ar main alokācijām
+            'bound': None if unresolved else lower_bound,
+            'lower_bound': lower_bound,
+            'malloc_margin': malloc_margin
+        }
+
+    def generate_heap_report(self, static_analysis, data_size):
+        """Ģenerē kaudzes analīzes sadaļu un steka/kaudzes sadursmes vērtējumu."""
+        heap = static_analysis['heap']
+        resolved = sum(1 for site in heap['sites'] if site[3] == 'constant')
+        annotated = sum(1 for site in heap['sites'] if site[3] == 'annotation')
+        unknown_size = sum(1 for site in heap['sites'] if site[2] is None)
+        
+        report = [
+            "",
+            "Heap Analysis:",
+            "-" * 30,
+            f"Allocation Sites: {len(heap['sites'])} (constant: {resolved}, annotated: {annotated}, unresolved: {unknown_size})",
+        ]
+        for func_name, kind, size, source, lifetime, looped in heap['sites']:
+            size_str = f"{size} bytes" if size is not None else "unknown size"
+            report.append(f"  {func_name}: {kind} {size_str} ({source}, {lifetime}{', in a loop' if looped else ''})")
+        for root, persistent, transient, bound in heap['roots']:
+            report.append(f"{root}: persistent {persistent} bytes, transient peak {transient} bytes, bound {bound} bytes")
+        
+        if heap['bound'] is None:
+            report.append(f"Heap Bound: UNKNOWN (at least {heap['lower_bound']} bytes with {MALLOC_HEADER_SIZE} bytes allocator overhead per block)")
+            report.append("WARNING: the heap bound is a lower bound only; bound these allocations with @heap/@heap-count annotations:")
+            for site in heap['unresolved']:
+                report.append(f"  {site}")
+        else:
+            report.append(f"Heap Bound (with {MALLOC_HEADER_SIZE} bytes allocator overhead per block): {heap['bound']} bytes")
+        report.append(f"Malloc Margin (__malloc_margin): {heap['malloc_margin']} bytes")
+        
+        free_space = self.ram_size - data_size - heap['lower_bound'] - static_analysis['max_stack_usage']
+        if heap['bound'] is None:
+            report.append(f"Free Space After Heap and Stack: at most {free_space} bytes")
+        else:
+            report.append(f"Free Space After Heap and Stack: {free_space} bytes")
+        
+        if heap['unresolved']:
+            report.append(f"Stack/Heap Collision: UNKNOWN ({len(heap['unresolved'])} unbounded allocation sites)")
+        elif free_space < 0:
+            report.append(f"Stack/Heap Collision: POSSIBLE (short by {-free_space} bytes)")
+        elif free_space < heap['malloc_margin']:
+            report.append("Stack/Heap Collision: NO, but malloc may return NULL within __malloc_margin of the stack")
+        else:
+            report.append("Stack/Heap Collision: NO")
+        
+        return report
+
+    def get_device_macros(self):
+        """
+        Atgriež ierīces galvenes makrodefinīcijas (avr-gcc -E -dM) vai None, ja tās nav pieejamas.
+        Rezultāts tiek saglabāts analizatorā, lai vektoru numuri un atmiņas robežas neizsauktu avr-gcc atkārtoti.
+        """
+        if 'macros' in self.device_cache:
+            return self.device_cache['macros']
+        try:
+            result = run_tool(
+                ["avr-gcc", f"-mmcu={self.mcu_type}", "-E", "-dM", "-x", "c", "-"],
+                input="#include <avr/io.h>\n", capture_output=True, text=True
+            )
+            macros = result.stdout if result.returncode == 0 else None
+        except OSError:
+            macros = None
+        self.device_cache['macros'] = macros
+        return macros
+
+    def get_vector_numbers(self):
+        """Iegūst pārtraukumu vektoru nosaukumu numurus no ierīces galvenes makrodefinīcijām (avr-gcc -E -dM)."""
+        macros = self.get_device_macros()
+        if macros is None:
+            logger.warning("Could not read interrupt vector definitions for the device")
+            return {}
+        
+        vector_numbers = {}
+        for match in re.finditer(r'^#define\s+(\w+_vect)_num\s+(\d+)', macros, re.MULTILINE):
+            vector_numbers[match.group(1)] = int(match.group(2))
+        for match in re.finditer(r'^#define\s+(\w+_vect)\s+_VECTOR\((\d+)\)', macros, re.MULTILINE):
+            vector_numbers.setdefault(match.group(1), int(match.group(2)))
+        return vector_numbers
+
+    def get_device_memory(self):
+        """
+        Nolasa iekšējās SRAM robežas (RAMSTART, RAMEND) un ārējās atmiņas beigas (XRAMEND)
+        no ierīces galvenes. Atgriež {'ram_start', 'ram_end', 'xram_end'} vai None.
+        """
+        macros = self.get_device_macros()
+        if macros is None:
+            return None
+        definitions = dict(re.findall(r'^#define\s+(\w+)\s+(.+?)\s*$', macros, re.MULTILINE))
+        
+        def value(name, depth=0):
+            """Atrisina makro vērtību; vērtība var būt cits makro (piem., RAMEND -> INTERNAL_SRAM_END)."""
+            text = definitions.get(name)
+            if text is None or depth > 8:
+                return None
+            text = text.strip()
+            while text.startswith('(') and text.endswith(')'):
+                text = text[1:-1].strip()
+            number = re.fullmatch(r'(0[xX][0-9a-fA-F]+|\d+)[uUlL]*', text)
+            if number:
+                return int(number.group(1), 0)
+            if re.fullmatch(r'\w+', text):
+                return value(text, depth + 1)
+            return None
+        
+        memory = {'ram_start': value('RAMSTART'), 'ram_end': value('RAMEND'), 'xram_end': value('XRAMEND')}
+        if memory['ram_start'] is None or memory['ram_end'] is None:
+            return None
+        return memory
+
+    def collect_interrupt_levels(self, asm_code):
+        """
+        Nosaka pārtraukumu apstrādātājus un (XMEGA) to prioritātes līmeņus no anotācijām
+        vai INTCTRL reģistru ierakstiem avota kodā, kā arī PMIC.CTRL ieslēgtos līmeņus.
+        Atgriež {'xmega': bool, 'vectors': {vektors: (līmenis vai None, avots)}, 'enabled_levels': [...]}.
+        """
+        vectors = sorted(
+            {match.group(1) for match in re.finditer(r'^[0-9a-f]+ <(__vector_\d+)>:', asm_code, re.MULTILINE)},
+            key=lambda name: int(name.rsplit('_', 1)[1])
+        )
+        xmega = self.mcu_type.lower().startswith('atxmega')
+        model = {'xmega': xmega, 'vectors': {vector: (None, 'unknown') for vector in vectors}, 'enabled_levels': []}
+        if not vectors or not xmega:
+            return model
+        
+        level_names = {'lo': 'low', 'low': 'low', 'med': 'medium', 'medium': 'medium', 'hi': 'high', 'high': 'high', 'off': 'off'}
+        source = self.source_content or ""
+        vector_numbers = {}
+        if re.search(r'INTCTRL|@isr-level\s+[A-Za-z]', source):
+            vector_numbers = self.get_vector_numbers()
+        
+        def vector_function(name):
+            """Pārveido vektora nosaukumu (TCC0_OVF_vect, __vector_14, 14) par funkcijas nosaukumu."""
+            if re.fullmatch(r'__vector_\d+', name):
+                return name
+            if name.isdigit():
+                return f"__vector_{name}"
+            if name in vector_numbers:
+                return f"__vector_{vector_numbers[name]}"
+            return None
+        
+        # INTCTRL ieraksti: TCC0.INTCTRLA = TC_OVFINTLVL_HI_gc; USARTC0.INTCTRL |= USART_RXCINTLVL_MED_gc; ...
+        detected = {}
+        for match in re.finditer(r'\b(\w+(?:\.\w+)*)[._]INTCTRL[A-Z]?\s*\|?=\s*([^;]+);', source):
+            parts = match.group(1).split('.')
+            for level_match in re.finditer(r'\b[A-Z0-9]+_([A-Z0-9_]*?)LVL_(OFF|LO|MED|HI)_gc\b', match.group(2)):
+                raw_source = level_match.group(1)
+                interrupt_source = re.sub(r'_?INT$', '', raw_source).rstrip('_')
+                candidates = []
+                if interrupt_source and not parts[-1].startswith(interrupt_source):
+                    candidates.append('_'.join(parts + [interrupt_source]) + '_vect')
+                if raw_source.rstrip('_'):
+                    candidates.append('_'.join(parts + [raw_source.rstrip('_')]) + '_vect')
+                candidates.append('_'.join(parts) + '_vect')
+                
+                name = next((candidate for candidate in candidates if candidate in vector_numbers), None)
+                function = vector_function(name) if name else None
+                if function is None:
+                    logger.warning(f"Could not map {match.group(1)} interrupt ({level_match.group(0)}) to a vector")
+                    continue
+                detected.setdefault(function, set()).add(level_names[level_match.group(2).lower()])
+        
+        for function, levels in detected.items():
+            if function not in model['vectors']:
+                continue
+            active = levels - {'off'}
+            if len(active) == 1:
+                model['vectors'][function] = (active.pop(), 'INTCTRL')
+            elif not active:
+                model['vectors'][function] = ('off', 'INTCTRL')
+            else:
+                # Dažādi līmeņi dažādās vietās - līmenis nav viennozīmīgs
+                logger.warning(f"Interrupt {function} is configured with several levels: {sorted(active)}")
+        
+        # Anotācijas avota kodā: // @isr-level <vektors> <low|medium|high|off>
+        for match in re.finditer(r'@isr-level\s+(\w+)\s+(low|medium|high|lo|med|hi|off)\b', source, re.IGNORECASE):
+            function = vector_function(match.group(1))
+            if function in model['vectors']:
+                model['vectors'][function] = (level_names[match.group(2).lower()], 'annotation')
+            else:
+                logger.warning(f"Annotated interrupt {match.group(1)} has no handler in the program")
+        
+        def pmic_levels(value):
+            """Ieslēgtie līmeņi no PMIC.CTRL vērtības vai None, ja kādu locekli nevar atpazīt."""
+            levels = set()
+            for term in value.split('|'):
+                term = term.strip().strip('()').strip()
+                level_match = re.fullmatch(r'PMIC_(LO|MED|HI)LVLEN_bm', term)
+                number_match = re.fullmatch(r'(0[xX][0-9a-fA-F]+|0[bB][01]+|\d+)[uU]?', term)
+                if level_match:
+                    levels.add(level_names[level_match.group(1).lower()])
+                elif number_match:
+                    # LOLVLEN, MEDLVLEN, HILVLEN ir biti 0, 1, 2
+                    bits = int(number_match.group(1), 0)
+                    levels.update(level for bit, level in enumerate(INTERRUPT_LEVELS) if bits & (1 << bit))
+                elif not re.fullmatch(r'PMIC_(RREN|IVSEL)_bm', term):
+                    return None
+            return levels
+        
+        # PMIC.CTRL = PMIC_LOLVLEN_bm | PMIC_HILVLEN_bm; PMIC.CTRL = 0x07;
+        pmic_writes = re.findall(r'\bPMIC[._]CTRL\s*\|?=\s*([^;]+);', source)
+        parsed = [pmic_levels(value) for value in pmic_writes]
+        if not pmic_writes:
+            logger.warning("No PMIC.CTRL write found, assuming all interrupt levels are enabled")
+            enabled = set(INTERRUPT_LEVELS)
+        elif None in parsed:
+            unparsed = next(value for value, levels in zip(pmic_writes, parsed) if levels is None)
+            logger.warning(f"Could not parse PMIC.CTRL value '{unparsed.strip()}', assuming all interrupt levels are enabled")
+            enabled = set(INTERRUPT_LEVELS)
+        else:
+            enabled = set().union(*parsed)
+        model['enabled_levels'] = [level for level in INTERRUPT_LEVELS if level in enabled]
+        
+        return model
+
+    def calculate_interrupt_stack(self, interrupt_model, main_usage, call_graph, function_stack_usage, recursive_functions, recursion_limits):
+        """
+        Aprēķina pārtraukumu papildu steka izmantojumu. Klasiskajiem AVR pārtraukumi neligzdojas:
+        main + lielākā ISR ķēde. XMEGA augstāka līmeņa pārtraukums var pārtraukt zemāka līmeņa
+        apstrādātāju: main + lielākā ķēde katrā ieslēgtajā līmenī. Vektori ar nezināmu līmeni
+        tiek izvietoti līmeņos tā, lai kopsumma būtu maksimāla.
+        """
+        chains = {}
+        for vector in interrupt_model['vectors']:
+            chains[vector] = self.find_worst_chain(
+                vector, call_graph, function_stack_usage, recursive_functions, recursion_limits
+            )[0]
+        
+        if not interrupt_model['xmega']:
+            worst = max(chains, key=lambda vector: chains[vector], default=None)
+            levels = ((None, worst, chains[worst]),) if worst else ()
+        else:
+            enabled = interrupt_model['enabled_levels']
+            known = {level: (None, 0) for level in enabled}
+            unknown = []
+            for vector, (level, _) in interrupt_model['vectors'].items():
+                if level is None:
+                    unknown.append(vector)
+                elif level in known and chains[vector] > known[level][1]:
+                    known[level] = (vector, chains[vector])
+            
+            # Tikai lielākie nezināmie vektori (ne vairāk kā līmeņu skaits) var ietekmēt maksimumu
+            unknown = sorted(unknown, key=lambda vector: chains[vector], reverse=True)[:len(enabled)]
+            best_total, best_levels = -1, None
+            for placement in itertools.product([None] + unknown, repeat=len(enabled)):
+                chosen = [vector for vector in placement if vector is not None]
+                if len(chosen) != len(set(chosen)):
+                    continue
+                candidate = [
+                    (level, vector, chains[vector]) if vector is not None and chains[vector] > known[level][1]
+                    else (level, known[level][0], known[level][1])
+                    for level, vector in zip(enabled, placement)
+                ]
+                total = sum(usage for _, _, usage in candidate)
+                if total > best_total:
+                    best_total, best_levels = total, candidate
+            levels = tuple(entry for entry in (best_levels or []) if entry[1] is not None)
+        
+        interrupt_usage = sum(usage for _, _, usage in levels)
+        logger.info(f"Interrupt stack usage: {interrupt_usage} bytes ({levels})")
+        
+        return {
+            'model': 'xmega' if interrupt_model['xmega'] else 'classic',
+            'main_usage': main_usage,
+            'interrupt_usage': interrupt_usage,
+            'levels': levels,
+            'vectors': tuple(
+                (vector, level, origin, chains[vector])
+                for vector, (level, origin) in interrupt_model['vectors'].items()
+            ),
+            'enabled_levels': tuple(interrupt_model['enabled_levels'])
+        }
+
+    def generate_interrupt_report(self, static_analysis):
+        """Ģenerē pārtraukumu ligzdošanas modeļa sadaļu."""
+        interrupts = static_analysis['interrupts']
+        report = [
+            "",
+            "Interrupt Nesting:",
+            "-" * 30,
+        ]
+        if interrupts['model'] == 'xmega':
+            enabled = ", ".join(interrupts['enabled_levels']) or "none"
+            report.append(f"Model: XMEGA PMIC (enabled levels: {enabled})")
+        else:
+            report.append("Model: classic AVR (interrupts do not nest)")
+        
+        for vector, level, origin, usage in interrupts['vectors']:
+            if interrupts['model'] == 'xmega':
+                level_str = f"level {level} ({origin})" if level else "level unknown"
+                report.append(f"{vector}: {usage} bytes, {level_str}")
+            else:
+                report.append(f"{vector}: {usage} bytes")
+        
+        report.append(f"Main Path Stack Usage: {interrupts['main_usage']} bytes")
+        for level, vector, usage in interrupts['levels']:
+            prefix = f"{level} level" if level else "Largest interrupt"
+            report.append(f"{prefix.capitalize()}: {vector} (+{usage} bytes)")
+        report.append(f"Interrupt Stack Usage: {interrupts['interrupt_usage']} bytes")
+        
+        return report
+
+    def collect_prototypes(self):
+        """Iegūst funkciju prototipus no DWARF atkļūdošanas informācijas (avr-objdump --dwarf=info)."""
+        result = run_tool(
+            ["avr-objdump", "--dwarf=info", self.elf_file],
+            capture_output=True, text=True
+        )
+        if result.returncode != 0:
+            logger.warning("Could not read DWARF information, argument passing analysis disabled")
+            return {'definitions': {}, 'declarations': {}}
+        return self.parse_dwarf_prototypes(result.stdout)
+
+    def parse_dwarf_prototypes(self, dwarf_text):
+        """
+        Parsē DWARF DIE koku un atgriež funkciju prototipus {'variadic': bool, 'return_size': int,
+        'params': [(nosaukums, izmērs, ir_struktūra)]}: definīcijas pēc koda adreses (DW_AT_low_pc),
+        jo static funkcijām dažādās kompilācijas vienībās var būt vienāds nosaukums,
+        un deklarācijas bez koda (piem., bibliotēkas funkcijas) pēc nosaukuma.
+        Atgriež {'definitions': {adrese: prototips}, 'declarations': {funkcija: prototips}}.
+        """
+        die_pattern = re.compile(r'^\s*<(\d+)><([0-9a-f]+)>: Abbrev Number: \d+(?: \((\w+)\))?')
+        attr_pattern = re.compile(r'^\s*<[0-9a-f]+>\s+(DW_AT_\w+)\s*:\s*(.*)$')
+        
+        dies = {}
+        parents = {}
+        current = None
+        for line in dwarf_text.split('\n'):
+            die_match = die_pattern.match(line)
+            if die_match:
+                depth, offset, tag = int(die_match.group(1)), int(die_match.group(2), 16), die_match.group(3)
+                parents[depth] = offset
+                current = {'tag': tag, 'attrs': {}, 'parent': parents.get(depth - 1), 'children': []}
+                dies[offset] = current
+                if current['parent'] in dies and tag:
+                    dies[current['parent']]['children'].append(offset)
+                continue
+            attr_match = attr_pattern.match(line)
+            if attr_match and current is not None:
+                name, value = attr_match.groups()
+                # Netiešās virknes: "(indirect string, offset: 0x12): uint8_t"
+                if value.startswith('(indirect') and '): ' in value:
+                    value = value.rsplit('): ', 1)[1]
+                current['attrs'][name] = value.strip()
+        
+        def type_ref(die):
+            ref_match = re.match(r'<0x([0-9a-f]+)>', die['attrs'].get('DW_AT_type', ''))
+            return int(ref_match.group(1), 16) if ref_match else None
+        
+        def type_info(offset, depth=0):
+            """Atgriež (izmērs, ir_struktūra) tipam, sekojot typedef/const/volatile."""
+            die = dies.get(offset)
+            if die is None or depth > 20:
+                return 0, False
+            if 'DW_AT_byte_size' in die['attrs']:
+                try:
+                    size = int(die['attrs']['DW_AT_byte_size'].split()[0], 0)
+                except ValueError:
+                    size = 0
+                return size, die['tag'] in ('DW_TAG_structure_type', 'DW_TAG_union_type')
+            return type_info(type_ref(die), depth + 1)
+        
+        definitions = {}
+        declarations = {}
+        for die in dies.values():
+            if die['tag'] != 'DW_TAG_subprogram' or 'DW_AT_name' not in die['attrs']:
+                continue
+            name = die['attrs'].get('DW_AT_linkage_name', die['attrs']['DW_AT_name'])
+            low_pc = re.match(r'0x([0-9a-f]+)', die['attrs'].get('DW_AT_low_pc', ''))
+            
+            params = []
+            variadic = False
+            for child in die['children']:
+                child_die = dies[child]
+                if child_die['tag'] == 'DW_TAG_formal_parameter':
+                    size, is_struct = type_info(type_ref(child_die))
+                    params.append((child_die['attrs'].get('DW_AT_name', '?'), size, is_struct))
+                elif child_die['tag'] == 'DW_TAG_unspecified_parameters':
+                    variadic = True
+            
+            return_size = type_info(type_ref(die))[0] if type_ref(die) is not None else 0
+            prototype = {'variadic': variadic, 'return_size': return_size, 'params': params}
+            if low_pc:
+                definitions[int(low_pc.group(1), 16)] = prototype
+            else:
+                declarations.setdefault(name, prototype)
+        
+        logger.info(f"Collected DWARF prototypes for {len(definitions)} functions and {len(declarations)} declarations")
+        return {'definitions': definitions, 'declarations': declarations}
+
+    def classify_arguments(self, prototype):
+        """
+        Sadala argumentus pēc avr-gcc ABI: reģistri r25 līdz r8 (18 baiti), katrs arguments
+        aizņem pāra skaitu reģistru. Ja arguments neietilpst atlikušajos reģistros, tas un visi
+        nākamie tiek nodoti stekā. Mainīga garuma funkcijām visi argumenti tiek nodoti stekā.
+        Atgriež (steka baiti, struktūru kopēšanas baiti).
+        """
+        free_registers = 0 if prototype['variadic'] else ARGUMENT_REGISTER_BYTES
+        
+        # Lielas atgriežamās vērtības adrese tiek nodota kā slēpts arguments
+        if prototype['return_size'] > MAX_RETURN_REGISTER_BYTES and free_registers:
+            free_registers -= 2
+        
+        stack_bytes = 0
+        struct_bytes = 0
+        for _, size, is_struct in prototype['params']:
+            if is_struct:
+                struct_bytes += size
+            register_size = size + (size & 1)
+            if free_registers and register_size <= free_registers:
+                free_registers -= register_size
+            else:
+                free_registers = 0
+                stack_bytes += size
+        
+        return stack_bytes, struct_bytes
+
+    def analyze_call_argument_costs(self, asm_code, prototypes):
+        """
+        Klasificē izsaukumu vietas pēc argumentu nodošanas izmaksām. Izsauktās funkcijas prototips
+        tiek meklēts pēc mērķa adreses, tad pēc nosaukuma deklarācijās. Mainīga garuma funkcijām
+        stekā nodoto baitu skaits tiek novērtēts no PUSH instrukcijām pirms izsaukuma.
+        """
+        func_pattern = re.compile(r'^([0-9a-f]+) <([^>]+)>:')
+        call_pattern = re.compile(r'^\s*([0-9a-f]+):\s+[0-9a-f ]+\s+r?call\s+[^;]*;\s*0x([0-9a-f]+)\s+<([^>+]+)>')
+        definitions = prototypes.get('definitions', {})
+        declarations = prototypes.get('declarations', {})
+        push_pattern = re.compile(r'^\s*[0-9a-f]+:\s+[0-9a-f ]+\s+push\s+r\d+')
+        frame_setup_pattern = re.compile(r'^\s*[0-9a-f]+:\s+[0-9a-f ]+\s+(?:in\s+r2[89],\s*0x3[de]|out\s+0x3[de],)')
+        
+        sites = []
+        current_function = None
+        pushes_since_call = 0
+        
+        for line in asm_code.split('\n'):
+            func_match = func_pattern.match(line)
+            if func_match:
+                func_name = func_match.group(2)
+                if '^' in func_name or func_name.startswith('.L'):
+                    continue
+                current_function = func_name
+                pushes_since_call = 0
+                continue
+            
+            if not current_function:
+                continue
+            
+            # Prologa PUSH instrukcijas netiek skaitītas kā argumenti
+            if frame_setup_pattern.match(line):
+                pushes_since_call = 0
+                continue
+            if push_pattern.match(line):
+                pushes_since_call += 1
+                continue
+            
+            call_match = call_pattern.match(line)
+            if not call_match:
+                continue
+            
+            addr, target, callee = call_match.groups()
+            pushed = pushes_since_call
+            pushes_since_call = 0
+            
+            prototype = definitions.get(int(target, 16)) or declarations.get(callee)
+            if not prototype:
+                continue
+            
+            stack_bytes, struct_bytes = self.classify_arguments(prototype)
+            if prototype['variadic']:
+                stack_bytes = max(stack_bytes, pushed)
+            if not stack_bytes and not struct_bytes:
+                continue
+            
+            # Cikli: PUSH 2 cikli/baits, attīrīšana ar POP (2 cikli/baits) vai SP korekcija,
+            # struktūras kopēšana no atmiņas 2 cikli/baits
+            cleanup_cycles = 2 * stack_bytes if stack_bytes <= SMALL_STACK_CLEANUP_BYTES else SP_ADJUST_CYCLES
+            cycles = 2 * stack_bytes + (cleanup_cycles if stack_bytes else 0) + 2 * struct_bytes
+            
+            sites.append({
+                'caller': current_function,
+                'callee': callee,
+                'address': addr,
+                'stack_bytes': stack_bytes,
+                'struct_bytes': struct_bytes,
+                'variadic': prototype['variadic'],
+                'cycles': cycles
+            })
+            logger.debug(f"Call {current_function} -> {callee} at 0x{addr}: stack {stack_bytes} bytes, "
+                         f"struct copy {struct_bytes} bytes, ~{cycles} cycles")
+        
+        return sites
+
+    def generate_argument_cost_report(self, static_analysis, sites):
+        """Ģenerē izsaukumu vietu sarakstu ar argumentu nodošanas izmaksām un sliktākā ceļa ranžējumu."""
+        report = [
+            "",
+            "Argument Passing Cost (stack bytes are included in the caller's frame):",
+            "-" * 30,
+        ]
+        for site in sites:
+            kinds = []
+            if site['variadic']:
+                kinds.append("varargs")
+            if site['struct_bytes']:
+                kinds.append(f"struct copy {site['struct_bytes']} bytes")
+            kind_str = f" ({', '.join(kinds)})" if kinds else ""
+            report.append(f"{site['caller']} -> {site['callee']} @0x{site['address']}: "
+                          f"{site['stack_bytes']} stack bytes, ~{site['cycles']} cycles{kind_str}")
+        
+        # Izsaukumu vietas sliktākā gadījuma ceļos (main un pieskaitītie pārtraukumi)
+        _, chains = self.worst_case_chains(static_analysis)
+        worst_edges = set()
+        for chain in chains:
+            worst_edges |= {(chain[i][0], chain[i + 1][0]) for i in range(len(chain) - 1)}
+            # Rekursīvās funkcijas ceļā izsauc pašas sevi
+            worst_edges |= {(func, func) for func, multiplicity in chain if multiplicity > 1}
+        worst_sites = [site for site in sites if (site['caller'], site['callee']) in worst_edges]
+        worst_sites.sort(key=lambda site: (site['stack_bytes'], site['cycles']), reverse=True)
+        
+        if worst_sites:
+            report.append("")
+            report.append("On Worst-Case Stack Paths, main and interrupts (ranked):")
+            report.append("-" * 30)
+            for i, site in enumerate(worst_sites):
+                report.append(f"{i+1}. {site['caller']} -> {site['callee']}: {site['stack_bytes']} stack bytes, "
+                              f"~{site['cycles']} cycles")
+        
+        return report
+
+    def get_memory_sections(self):
+        """Iegūst .data un .bss sekciju izmērus no ELF faila"""
+        result = run_tool(
+            ["avr-size", self.elf_file],
+            capture_output=True, text=True
+        )
+        # Parsē izvadi: "text    data     bss"
+        lines = result.stdout.strip().split('\n')
+        if len(lines) >= 2:
+            sizes = lines[1].split()
+            return {
+                'data': int(sizes[1]),
+                'bss': int(sizes[2])
+            }
+        return {'data': 0, 'bss': 0}
+
+    def get_section_headers(self):
+        """Iegūst RAM sekciju adreses un izmērus no ELF faila (avr-objdump -h)"""
+        result = run_tool(
+            ["avr-objdump", "-h", self.elf_file],
+            capture_output=True, text=True, check=True
+        )
+        # Parsē rindas: "  1 .data  00000002  00800100  000000c6  00000154  2**0"
+        header_pattern = re.compile(r'^\s*\d+\s+(\S+)\s+([0-9a-f]+)\s+([0-9a-f]+)\s+[0-9a-f]+\s+[0-9a-f]+')
+        headers = {}
+        for line in result.stdout.split('\n'):
+            match = header_pattern.match(line)
+            if not match:
+                continue
+            name, size_str, vma_str = match.groups()
+            vma = int(vma_str, 16)
+            # AVR datu atmiņa ir adresēta no 0x800000 (EEPROM sākas no 0x810000)
+            if DATA_MEMORY_OFFSET <= vma < EEPROM_MEMORY_OFFSET:
+                headers[name] = (vma - DATA_MEMORY_OFFSET, int(size_str, 16))
+                logger.debug(f"RAM section {name}: address 0x{vma - DATA_MEMORY_OFFSET:x}, size {int(size_str, 16)} bytes")
+        return headers
+
+    def get_data_symbols(self):
+        """Iegūst datu atmiņas simbolus ar adresēm un izmēriem no ELF simbolu tabulas (avr-objdump -t)"""
+        result = run_tool(
+            ["avr-objdump", "-t", self.elf_file],
+            capture_output=True, text=True
+        )
+        if result.returncode != 0:
+            logger.warning("Could not read symbol table")
+            return {}
+        # Parsē rindas: "00800100 l     O .bss	00000002 counter"
+        symbol_pattern = re.compile(r'^([0-9a-f]+) (.{7}) (\S+)\s+([0-9a-f]+)\s+(\S+)$')
+        symbols = {}
+        for line in result.stdout.split('\n'):
+            match = symbol_pattern.match(line)
+            if not match:
+                continue
+            addr_str, _, section, size_str, name = match.groups()
+            vma = int(addr_str, 16)
+            if DATA_MEMORY_OFFSET <= vma < EEPROM_MEMORY_OFFSET:
+                symbols[name] = (vma - DATA_MEMORY_OFFSET, int(size_str, 16), section)
+        return symbols
+
+    def generate_report(self, static_analysis, sections=None):
+        """Ģenerē visaptverošu pārskatu par steka izmantojuma analīzi."""
+        if sections is None:
+            sections = self.get_memory_sections()
+        data_size = sections.get('data', 0) + sections.get('bss', 0)
+        available_stack = self.ram_size - data_size
+        
+        # Teksta atskaite
+        report = [
+            f"Stack Analysis Report for {os.path.basename(self.source_file)}",
+            "=" * 60,
+            f"MCU Type: {self.mcu_type}",
+            f"RAM Size: {self.ram_size} bytes",
+            f"Data Size (.data + .bss): {data_size} bytes",
+            f"Available Stack Space: {available_stack} bytes",
+            "",
+            "Static Analysis Results:",
+            "-" * 30,
+            f"Maximum Stack Usage (with 10% safety margin): {static_analysis['max_stack_usage']} bytes",
+            f"Calculated Stack Usage: {static_analysis['raw_max_usage']} bytes",
+            f"Free Stack Space: {int(available_stack - static_analysis['max_stack_usage'])} bytes",
+            f"Stack Usage Percentage: {(static_analysis['max_stack_usage'] / self.ram_size * 100):.1f}%",
+            "",
+            f"Function Stack Usage (includes {self.return_address_size()} bytes return addr):",
+            "-" * 30,
+        ]
+        
+        # Kārto funkcijas pēc steka lietojuma (dilstošā secībā)
+        sorted_functions = sorted(
+            static_analysis['function_usage'].items(),
+            key=lambda x: x[1],
+            reverse=True
+        )
+        
+        # Pievieno informāciju par funkcijām
+        for function, usage in sorted_functions:
+            report.append(f"{function}: {usage} bytes")
+            
+        # Pievieno rekursīvo funkciju informāciju, ja tāda ir
+        if static_analysis['recursive_functions']:
+            report.append("")
+            report.append("Recursive Functions (detected from assembly):")
+            report.append("-" * 30)
+            for func in static_analysis['recursive_functions']:
+                limit = static_analysis['recursion_limits'].get(func, "unknown")
+                reduce_info = static_analysis['reduction_info'].get(func, {})
+
+                # Formatē rekursijas veidu ar faktoru
+                recursion_type = reduce_info.get('type', 'unknown')
+                factor = reduce_info.get('value', 1)
+                
+                if recursion_type == 'subtraction':
+                    type_str = f"subtraction by {factor}"
+                elif recursion_type == 'division':
+                    type_str = f"division by {factor}"
+                elif recursion_type == 'override':
+                    type_str = "set by --recursion-limit"
+                else:
+                    type_str = recursion_type
+                
+                report.append(f"{func} (recursion limit: {limit}, type: {type_str})")
         
         # Pievieno izsaukuma grafa informāciju
         if static_analysis['call_graph']:
@@ -1530,55 +3375,865 @@ class AVRCStackAnalyzer:
             for i, path_info in enumerate(static_analysis['all_paths']):
                 report.append(f"{i+1}. {path_info['details']}")
 
+        # Pievieno pārtraukumu ligzdošanas modeli, ja programmā ir pārtraukumu apstrādātāji
+        if static_analysis.get('interrupts'):
+            report.extend(self.generate_interrupt_report(static_analysis))
+
+        # Pievieno kaudzes analīzi, ja programmā ir alokācijas
+        if static_analysis.get('heap'):
+            report.extend(self.generate_heap_report(static_analysis, data_size))
+
         return "\n".join(report)
 
-# Galvenā analīzes funkcija
-def analyze_stack(source_file, mcu_type="atmega328p", ram_size=2048, optimization="O0", extra_flags=None):
-    """Analizē steka izmantojumu AVR C sākuma failam."""
+# Bibliotēkas API: analīze pa posmiem (build, load image, decode, graph, solve, report).
+# Katrs posms atgriež nemainīgu artefaktu ar satura kontrolsummu (key), ko var kešot,
+# atkārtoti izmantot ar citu konfigurāciju un nodot starp procesiem.
+
+# Artefaktu formāta versija: jāpalielina, ja mainās artefaktu lauki vai to saturs
+ARTIFACT_SCHEMA_VERSION = 5
+
+def _digest(*parts):
+    """Aprēķina SHA-256 kontrolsummu no teksta vai baitu daļām."""
+    digest = hashlib.sha256()
+    for part in parts:
+        if isinstance(part, str):
+            part = part.encode('utf-8')
+        digest.update(part)
+        digest.update(b'\0')
+    return digest.hexdigest()
+
+def _file_digest(path):
+    """Aprēķina faila satura SHA-256 kontrolsummu."""
+    with open(path, 'rb') as f:
+        return _digest(f.read())
+
+# Analizatora pirmkoda kontrolsumma: izmainīta analīzes loģika nelieto vecos kešotos artefaktus
+ANALYZER_DIGEST = _file_digest(os.path.abspath(__file__))
+
+def _stage_key(stage, *parts):
+    """Posma keša atslēga: artefaktu versija, analizatora kontrolsumma un posma ievaddati."""
+    return _digest(stage, str(ARTIFACT_SCHEMA_VERSION), ANALYZER_DIGEST, *parts)
+
+def _freeze(value):
+    """Pārveido vārdnīcas, sarakstus un kopas nemainīgos kortežos."""
+    if isinstance(value, dict):
+        return tuple((key, _freeze(item)) for key, item in value.items())
+    if isinstance(value, (set, frozenset)):
+        return tuple(sorted(_freeze(item) for item in value))
+    if isinstance(value, (list, tuple)):
+        return tuple(_freeze(item) for item in value)
+    return value
+
+def _encode_json(value):
+    """Pārveido artefakta lauku JSON saderīgā formā."""
+    if isinstance(value, bytes):
+        return {'__bytes__': base64.b64encode(value).decode('ascii')}
+    if isinstance(value, tuple):
+        return [_encode_json(item) for item in value]
+    return value
+
+def _decode_json(value):
+    """Atjauno artefakta lauku no JSON formas."""
+    if isinstance(value, dict) and '__bytes__' in value:
+        return base64.b64decode(value['__bytes__'])
+    if isinstance(value, list):
+        return tuple(_decode_json(item) for item in value)
+    return value
+
+def _thaw_interrupt_model(frozen):
+    """Atjauno collect_interrupt_levels rezultātu no nemainīgās formas."""
+    if not frozen:
+        return None
+    model = dict(frozen)
+    return {
+        'xmega': model['xmega'],
+        'vectors': {vector: tuple(info) for vector, info in model['vectors']},
+        'enabled_levels': list(model['enabled_levels'])
+    }
+
+class Artifact:
+    """Kopīgā serializācija visiem posmu artefaktiem."""
+
+    def to_json(self):
+        return json.dumps({field.name: _encode_json(getattr(self, field.name)) for field in fields(self)})
+
+    @classmethod
+    def from_json(cls, text):
+        data = json.loads(text)
+        return cls(**{name: _decode_json(value) for name, value in data.items()})
+
+@dataclass(frozen=True)
+class BuildArtifact(Artifact):
+    """Kompilācijas rezultāts: ELF attēls un GCC .su steka izmantojums."""
+    key: str
+    source_file: str
+    source_content: str
+    mcu_type: str
+    optimization: str
+    compiler_flags: tuple
+    elf_image: bytes
+    stack_usage: tuple  # ((funkcija, baiti), ...)
+    function_origins: tuple = ()  # ((funkcija, (direktorija, bibliotēka, fails)), ...)
+    recursion_limits: tuple = ()  # ((funkcija, dziļums), ...) no --recursion-limit
+
+@dataclass(frozen=True)
+class ImageArtifact(Artifact):
+    """Ielādēts ELF attēls: disasamblētais kods un atmiņas sekciju izmēri."""
+    key: str
+    asm_code: str
+    sections: tuple  # (('data', baiti), ('bss', baiti))
+    section_headers: tuple = ()  # ((sekcija, (RAM adrese, baiti)), ...)
+    data_symbols: tuple = ()  # ((simbols, (RAM adrese, baiti, sekcija)), ...)
+    prototypes: tuple = ()  # DWARF prototipi: (('definitions', ((adrese, prototips), ...)), ('declarations', ((funkcija, prototips), ...)))
+    argument_sites: tuple = ()  # Izsaukumu vietas ar argumentu nodošanas izmaksām: (((caller, ...), ('callee', ...), ...), ...)
+
+@dataclass(frozen=True)
+class DecodedProgram(Artifact):
+    """Katras funkcijas steka izmantojums, aprēķināts no assemblera."""
+    key: str
+    function_usage: tuple
+
+@dataclass(frozen=True)
+class CallGraphArtifact(Artifact):
+    """Pilns izsaukumu grafs ar rekursijas informāciju."""
+    key: str
+    call_graph: tuple  # ((funkcija, (izsauktās funkcijas, ...)), ...)
+    function_usage: tuple
+    recursive_functions: tuple
+    recursion_limits: tuple
+    reduction_info: tuple
+    heap_sites: tuple = ()  # ((funkcija, (('allocations', ...), ('count', reizes vai None))), ...)
+    interrupt_model: tuple = ()  # (('xmega', bool), ('vectors', ...), ('enabled_levels', ...))
+    call_sites: tuple = ()  # ((izsaucējs, ((izsauktā funkcija, skaits vai None), ...)), ...)
+
+@dataclass(frozen=True)
+class StackSolution(Artifact):
+    """Maksimālā steka izmantojuma aprēķina rezultāts."""
+    key: str
+    max_stack_usage: int
+    raw_max_usage: int
+    function_usage: tuple
+    call_graph: tuple
+    recursive_functions: tuple
+    recursion_limits: tuple
+    reduction_info: tuple
+    all_paths: tuple  # ((ceļš, baiti, apraksts), ...)
+    heap: tuple = ()  # Kaudzes analīzes rezultāts (tukšs, ja nav alokāciju)
+    interrupts: tuple = ()  # Pārtraukumu ligzdošanas modelis (tukšs, ja nav pārtraukumu)
+
+    def to_analysis(self):
+        """Atgriež rezultātus vārdnīcas formā, ko izmanto generate_report."""
+        return {
+            'max_stack_usage': self.max_stack_usage,
+            'raw_max_usage': self.raw_max_usage,
+            'function_usage': dict(self.function_usage),
+            'call_graph': {func: list(callees) for func, callees in self.call_graph},
+            'recursive_functions': list(self.recursive_functions),
+            'recursion_limits': dict(self.recursion_limits),
+            'reduction_info': {func: dict(info) for func, info in self.reduction_info},
+            'all_paths': [
+                {'path': list(path), 'usage': usage, 'details': details}
+                for path, usage, details in self.all_paths
+            ],
+            'heap': dict(self.heap) if self.heap else None,
+            'interrupts': dict(self.interrupts) if self.interrupts else None
+        }
+
+class ArtifactCache:
+    """Posmu artefaktu kešs atmiņā un, ja norādīta direktorija, diskā (JSON faili)."""
+
+    def __init__(self, directory=None):
+        self.directory = directory
+        self.memory = {}
+        if directory:
+            os.makedirs(directory, exist_ok=True)
+
+    def _path(self, stage, key):
+        return os.path.join(self.directory, f"{stage}-{key}.json")
+
+    def get(self, stage, key, artifact_cls):
+        """Atgriež kešoto artefaktu vai None."""
+        if (stage, key) in self.memory:
+            logger.debug(f"Cache hit (memory): {stage} {key[:12]}")
+            return self.memory[(stage, key)]
+        if self.directory and os.path.exists(self._path(stage, key)):
+            with open(self._path(stage, key), 'r') as f:
+                artifact = artifact_cls.from_json(f.read())
+            self.memory[(stage, key)] = artifact
+            logger.debug(f"Cache hit (disk): {stage} {key[:12]}")
+            return artifact
+        logger.debug(f"Cache miss: {stage} {key[:12]}")
+        return None
+
+    def put(self, stage, artifact):
+        """Saglabā artefaktu kešā."""
+        self.memory[(stage, artifact.key)] = artifact
+        if self.directory:
+            # Ieraksta caur pagaidu failu, lai paralēli procesi neredzētu daļēju failu
+            path = self._path(stage, artifact.key)
+            tmp_path = f"{path}.{os.getpid()}.tmp"
+            with open(tmp_path, 'w') as f:
+                f.write(artifact.to_json())
+            os.replace(tmp_path, path)
+        return artifact
+
+def _cached(cache, stage, key, artifact_cls, compute, source_file=""):
+    """Atgriež artefaktu no keša vai aprēķina un saglabā to."""
+    with trace_span(stage, file=os.path.basename(source_file)) as span_args:
+        if cache is not None:
+            artifact = cache.get(stage, key, artifact_cls)
+            if artifact is not None:
+                span_args['cache'] = 'hit'
+                return artifact
+        span_args['cache'] = 'miss' if cache is not None else 'disabled'
+        artifact = compute()
+        if cache is not None:
+            cache.put(stage, artifact)
+        return artifact
+
+def source_dependencies(source_file, mcu_type, compiler_flags):
+    """Atgriež avota failu un visus tajā iekļautos galvenes failus (avr-gcc -M)."""
     try:
-        # Inicializē analizatoru
+        result = run_tool(
+            ["avr-gcc", f"-mmcu={mcu_type}", "-M", *compiler_flags, source_file],
+            capture_output=True, text=True
+        )
+    except OSError:
+        raise RuntimeError("Missing tools: avr-gcc")
+    if result.returncode != 0:
+        raise RuntimeError(f"Dependency scan failed: {result.stderr}")
+    # Make likums: "program.o: program.c /usr/lib/avr/include/avr/io.h \\ ..."
+    rule = result.stdout.replace('\\\n', ' ').split(':', 1)[1]
+    return [path.replace('\\ ', ' ') for path in re.split(r'(?<!\\)\s+', rule.strip()) if path]
+
+def build_key(source_file, mcu_type, optimization, compiler_flags):
+    """Posma 'build' keša atslēga no avota faila un visu iekļauto galvenes failu satura."""
+    dependencies = source_dependencies(source_file, mcu_type, compiler_flags)
+    return _stage_key('build', mcu_type, optimization, *compiler_flags, *(_file_digest(path) for path in dependencies))
+
+def artifact_from_analyzer(analyzer, key=None):
+    """Izveido BuildArtifact no analizatora, kuram jau izpildīts compile_c_code."""
+    with open(analyzer.elf_file, 'rb') as f:
+        elf_image = f.read()
+    stack_usage = analyzer.collect_stack_usage_reports()
+    function_origins = analyzer.collect_function_origins()
+    if key is None:
+        key = build_key(analyzer.source_file, analyzer.mcu_type, analyzer.optimization, analyzer.compiler_flags)
+    return BuildArtifact(
+        key=key,
+        source_file=analyzer.source_file,
+        source_content=analyzer.source_content,
+        mcu_type=analyzer.mcu_type,
+        optimization=analyzer.optimization,
+        compiler_flags=tuple(analyzer.compiler_flags),
+        elf_image=elf_image,
+        stack_usage=_freeze(stack_usage),
+        function_origins=_freeze(function_origins)
+    )
+
+def build_program(source_file, mcu_type="atmega328p", optimization="O0", compiler_flags=None, cache=None):
+    """
+    Posms 'build': kompilē C failu un savāc GCC steka izmantojumu.
+    Keša atslēga ietver avota faila un visu iekļauto galvenes failu saturu.
+    """
+    if not os.path.isfile(source_file):
+        raise FileNotFoundError(f"Source file not found: {source_file}")
+
+    compiler_flags = tuple(compiler_flags or ())
+    key = build_key(source_file, mcu_type, optimization, compiler_flags)
+
+    def compute():
         analyzer = AVRCStackAnalyzer(
-            source_file, 
-            mcu_type=mcu_type, 
-            ram_size=ram_size, 
+            source_file,
+            mcu_type=mcu_type,
             optimization=optimization,
-            compiler_flags=extra_flags
+            compiler_flags=list(compiler_flags)
         )
-        
-        # Kompilē kodu
         analyzer.compile_c_code()
-        
-        # Iegūst steka lietošanas pārskatu no GCC
-        gcc_stack_usage = analyzer.collect_stack_usage_reports()
-        
-        # Disamblē kodu
-        asm_code = analyzer.disassemble_avr()
-        
-        # Analizē statiskās steka lietojumu
-        static_analysis = analyzer.analyze_static_stack_usage(asm_code, gcc_stack_usage)
-        
-        # Ģenerē atskaiti
-        report = analyzer.generate_report(static_analysis)
-        
-        # Izdrukā pagaidu direktorijas ceļu atkļūdošanas nolūkos
-        logger.info(f"Temporary directory: {analyzer.temp_dir}")
-        
+        return artifact_from_analyzer(analyzer, key)
+
+    return _cached(cache, 'build', key, BuildArtifact, compute, source_file)
+
+def load_image(build_artifact, cache=None):
+    """
+    Posms 'load image': disasamblē ELF vai Intel HEX attēlu un nolasa atmiņas sekciju izmērus.
+    Attēliem bez simboliem (HEX, stripped ELF) funkcijas tiek atjaunotas no vektoru tabulas.
+    """
+    key = _stage_key('image', build_artifact.elf_image, build_artifact.mcu_type)
+
+    def compute():
+        temp_dir = tempfile.mkdtemp(prefix="avr_stack_analyzer_")
+        try:
+            analyzer = AVRCStackAnalyzer.for_artifact(build_artifact)
+            intel_hex = build_artifact.elf_image.lstrip()[:1] == b':'
+            analyzer.elf_file = os.path.join(temp_dir, "image.hex" if intel_hex else "image.elf")
+            with open(analyzer.elf_file, 'wb') as f:
+                f.write(build_artifact.elf_image)
+            if intel_hex:
+                asm_code, statics = analyzer.recover_functions(analyzer.disassemble_ihex())
+                if statics is None:
+                    logger.warning("Could not determine .data/.bss size from the startup code, assuming 0")
+                sections = statics or {'data': 0, 'bss': 0}
+                section_headers = {}
+                data_symbols = {}
+                prototypes = {'definitions': {}, 'declarations': {}}
+            else:
+                asm_code = analyzer.disassemble_avr()
+                if not re.search(r'^[0-9a-f]+ <main>:', asm_code, re.MULTILINE):
+                    logger.info("No symbols found in ELF image, recovering functions from the vector table")
+                    asm_code, _ = analyzer.recover_functions(asm_code)
+                sections = analyzer.get_memory_sections()
+                section_headers = analyzer.get_section_headers()
+                data_symbols = analyzer.get_data_symbols()
+                prototypes = analyzer.collect_prototypes()
+            argument_sites = analyzer.analyze_call_argument_costs(asm_code, prototypes)
+        finally:
+            shutil.rmtree(temp_dir)
+        return ImageArtifact(
+            key=key,
+            asm_code=asm_code,
+            sections=_freeze(sections),
+            section_headers=_freeze(section_headers),
+            data_symbols=_freeze(data_symbols),
+            prototypes=_freeze(prototypes),
+            argument_sites=_freeze(argument_sites)
+        )
+
+    return _cached(cache, 'image', key, ImageArtifact, compute, build_artifact.source_file)
+
+def decode_image(build_artifact, image, cache=None):
+    """Posms 'decode': aprēķina katras funkcijas steka izmantojumu."""
+    key = _stage_key('decode', image.key, json.dumps(build_artifact.stack_usage))
+
+    def compute():
+        analyzer = AVRCStackAnalyzer.for_artifact(build_artifact)
+        function_usage = analyzer.resolve_function_stack_usage(image.asm_code, dict(build_artifact.stack_usage))
+        return DecodedProgram(key=key, function_usage=_freeze(function_usage))
+
+    return _cached(cache, 'decode', key, DecodedProgram, compute, build_artifact.source_file)
+
+def build_graph(build_artifact, image, decoded, cache=None):
+    """Posms 'graph': izsaukumu grafs, rekursīvās funkcijas un rekursijas dziļums."""
+    key = _stage_key('graph', decoded.key, build_artifact.source_content, repr(build_artifact.recursion_limits))
+
+    def compute():
+        analyzer = AVRCStackAnalyzer.for_artifact(build_artifact)
+        gcc_stack_usage = dict(build_artifact.stack_usage)
+        call_graph, recursive_functions, recursion_limits, reduction_info = analyzer.analyze_call_structure(
+            image.asm_code, gcc_stack_usage
+        )
+        function_usage = dict(decoded.function_usage)
+        complete_call_graph = analyzer.link_call_graph(call_graph, function_usage, gcc_stack_usage, recursive_functions)
+        return CallGraphArtifact(
+            key=key,
+            call_graph=_freeze(complete_call_graph),
+            function_usage=_freeze(function_usage),
+            recursive_functions=_freeze(set(recursive_functions)),
+            recursion_limits=_freeze(recursion_limits),
+            reduction_info=_freeze(reduction_info),
+            heap_sites=_freeze(analyzer.collect_heap_sites(image.asm_code)),
+            interrupt_model=_freeze(analyzer.collect_interrupt_levels(image.asm_code)),
+            call_sites=_freeze(analyzer.count_call_sites(image.asm_code, gcc_stack_usage))
+        )
+
+    return _cached(cache, 'graph', key, CallGraphArtifact, compute, build_artifact.source_file)
+
+def solve_stack(build_artifact, graph_artifact, cache=None):
+    """Posms 'solve': maksimālais steka izmantojums un visi izsaukumu ceļi."""
+    key = _stage_key('solve', graph_artifact.key)
+
+    def compute():
+        analyzer = AVRCStackAnalyzer.for_artifact(build_artifact)
+        analysis = analyzer.solve_stack_usage(
+            dict(graph_artifact.function_usage),
+            {func: list(callees) for func, callees in graph_artifact.call_graph},
+            set(graph_artifact.recursive_functions),
+            dict(graph_artifact.recursion_limits),
+            {func: dict(info) for func, info in graph_artifact.reduction_info},
+            {func: dict(info) for func, info in graph_artifact.heap_sites},
+            _thaw_interrupt_model(graph_artifact.interrupt_model),
+            {func: dict(counts) for func, counts in graph_artifact.call_sites}
+        )
+        return StackSolution(
+            key=key,
+            max_stack_usage=analysis['max_stack_usage'],
+            raw_max_usage=analysis['raw_max_usage'],
+            function_usage=_freeze(analysis['function_usage']),
+            call_graph=_freeze(analysis['call_graph']),
+            recursive_functions=_freeze(analysis['recursive_functions']),
+            recursion_limits=_freeze(analysis['recursion_limits']),
+            reduction_info=_freeze(analysis['reduction_info']),
+            all_paths=tuple(
+                (tuple(path_info['path']), path_info['usage'], path_info['details'])
+                for path_info in analysis['all_paths']
+            ),
+            heap=_freeze(analysis['heap'] or {}),
+            interrupts=_freeze(analysis['interrupts'] or {})
+        )
+
+    return _cached(cache, 'solve', key, StackSolution, compute, build_artifact.source_file)
+
+def render_report(build_artifact, image, solution, ram_size=2048, breakdown=False):
+    """Posms 'report': teksta atskaite norādītajam RAM izmēram."""
+    with trace_span('report', file=os.path.basename(build_artifact.source_file)):
+        analyzer = AVRCStackAnalyzer.for_artifact(build_artifact, ram_size=ram_size)
+        analysis = solution.to_analysis()
+        report = analyzer.generate_report(analysis, sections=dict(image.sections))
+        # Argumentu nodošanas izmaksas, ja ir izsaukumi ar steka argumentiem vai struktūru kopijām
+        argument_sites = [dict(site) for site in image.argument_sites]
+        if argument_sites:
+            report += "\n" + "\n".join(analyzer.generate_argument_cost_report(analysis, argument_sites))
+        if breakdown:
+            report += "\n" + "\n".join(analyzer.generate_module_breakdown(analysis, dict(build_artifact.function_origins)))
         return report
-        
+
+def functions_from_asm(asm_code):
+    """Atrod funkciju simbolus disasamblētajā kodā (izmanto, ja nav pieejami .su faili)."""
+    func_pattern = re.compile(r'^([0-9a-f]+) <([^>]+)>:')
+    functions = {}
+    for line in asm_code.split('\n'):
+        match = func_pattern.match(line)
+        if not match:
+            continue
+        func_name = match.group(2)
+        # Izlaiž kompilatora atzīmes un sistēmas funkcijas
+        if '^' in func_name or func_name.startswith('.') or func_name == '_exit':
+            continue
+        if func_name.startswith('__') and not re.fullmatch(r'__vector_\d+', func_name):
+            continue
+        functions[func_name] = 0
+    return functions
+
+def is_image_file(path):
+    """Pārbauda, vai fails ir jau nokompilēts attēls (ELF vai Intel HEX), nevis C avota fails."""
+    return os.path.splitext(path)[1].lower() in IMAGE_EXTENSIONS
+
+def load_elf_program(elf_file, mcu_type="atmega328p", source_file=None, cache=None):
+    """
+    Posms 'build' jau nokompilētam ELF vai Intel HEX failam. Funkciju saraksts tiek iegūts no
+    disasamblētā koda (attēliem bez simboliem - ar sintētiskiem nosaukumiem).
+    Rekursijas dziļuma noteikšanai var norādīt avota failu.
+    """
+    if not os.path.isfile(elf_file):
+        raise FileNotFoundError(f"Image file not found: {elf_file}")
+    with open(elf_file, 'rb') as f:
+        elf_image = f.read()
+
+    source_content = ""
+    if source_file:
+        with open(source_file, 'r') as f:
+            source_content = f.read()
+
+    build_artifact = BuildArtifact(
+        key=_stage_key('elf', elf_image, source_content, mcu_type),
+        source_file=source_file or elf_file,
+        source_content=source_content,
+        mcu_type=mcu_type,
+        optimization="",
+        compiler_flags=(),
+        elf_image=elf_image,
+        stack_usage=()
+    )
+    image = load_image(build_artifact, cache)
+    logger.warning(f"No .su stack usage data for {os.path.basename(elf_file)}: frame sizes come from the "
+                   f"disassembly only, alloca() and variable-length arrays are not accounted for")
+    return replace(build_artifact, stack_usage=_freeze(functions_from_asm(image.asm_code)))
+
+def with_recursion_limits(build_artifact, recursion_limits=None):
+    """Pievieno artefaktam lietotāja norādītos rekursijas dziļumus (--recursion-limit)."""
+    if not recursion_limits:
+        return build_artifact
+    return replace(build_artifact, recursion_limits=_freeze(dict(sorted(recursion_limits.items()))))
+
+def run_stages(build_artifact, cache=None):
+    """Izpilda posmus load image, decode, graph un solve. Atgriež (image, solution)."""
+    image = load_image(build_artifact, cache)
+    decoded = decode_image(build_artifact, image, cache)
+    graph_artifact = build_graph(build_artifact, image, decoded, cache)
+    return image, solve_stack(build_artifact, graph_artifact, cache)
+
+def _ranges_overlap(first, second):
+    """Pārbauda, vai divi [sākums, beigas) adrešu apgabali pārklājas."""
+    return first[0] < second[1] and second[0] < first[1]
+
+def check_dual_image(images, ram_start, ram_size):
+    """
+    Pārbauda sāknēšanas ielādētāja un lietotnes atmiņas izvietojumu vienā atmiņas kartē.
+    images: {'bootloader': (image, solution), 'application': (image, solution)}
+    Atgriež vārdnīcu ar katra attēla reģioniem, atrastajām problēmām un kopējo rezervi.
+    """
+    ram_end = ram_start + ram_size  # Pirmā adrese aiz RAM
+    layout = {}
+
+    for role, (image, solution) in images.items():
+        headers = dict(image.section_headers)
+        statics = [(addr, addr + size) for name, (addr, size) in headers.items()
+                   if name in ('.data', '.bss', '.noinit') and size > 0]
+        statics_end = max((end for _, end in statics), default=ram_start)
+        noinit = headers.get('.noinit')
+        # Kaudze aug no statisko datu beigām uz steka pusi; nezināmai robežai izmanto apakšējo robežu
+        heap = dict(solution.heap) if solution.heap else None
+        heap_bound = heap['lower_bound'] if heap else 0
+        # Abi attēli izmanto vienu un to pašu steka virsotni (RAMEND)
+        stack = (ram_end - solution.max_stack_usage, ram_end)
+        layout[role] = {
+            'statics': statics,
+            'statics_size': sum(end - start for start, end in statics),
+            'statics_end': statics_end,
+            'noinit': (noinit[0], noinit[0] + noinit[1]) if noinit and noinit[1] > 0 else None,
+            'heap': heap_bound,
+            'heap_unknown': bool(heap and (heap['unresolved'] or heap['bound'] is None)),
+            'heap_unresolved': list(heap['unresolved']) if heap else [],
+            'stack': stack,
+            'stack_usage': solution.max_stack_usage,
+            'headroom': stack[0] - statics_end - heap_bound,
+        }
+
+    problems = []
+    for role, info in layout.items():
+        if info['heap_unknown']:
+            unresolved = ", ".join(info['heap_unresolved'][:3]) + (", ..." if len(info['heap_unresolved']) > 3 else "")
+            problems.append(f"{role}: heap size is UNKNOWN ({unresolved}), headroom uses the lower bound of {info['heap']} bytes")
+        if info['headroom'] < 0:
+            problems.append(f"{role}: stack overlaps .data/.bss/.noinit/heap by {-info['headroom']} bytes")
+
+    # Koplietotais .noinit pastkastītes apgabals
+    boot_noinit = layout['bootloader']['noinit']
+    app_noinit = layout['application']['noinit']
+    if boot_noinit and app_noinit and boot_noinit != app_noinit:
+        problems.append(
+            f"shared .noinit mismatch: bootloader 0x{boot_noinit[0]:x}-0x{boot_noinit[1]:x}, "
+            f"application 0x{app_noinit[0]:x}-0x{app_noinit[1]:x}"
+        )
+
+    # Nodošanas laikā viena attēla .noinit dati nedrīkst tikt pārrakstīti ar otra attēla
+    # .data/.bss inicializāciju vai steku
+    for owner, other in (('bootloader', 'application'), ('application', 'bootloader')):
+        mailbox = layout[owner]['noinit']
+        if not mailbox:
+            continue
+        other_regions = [region for region in layout[other]['statics'] if region != layout[other]['noinit']]
+        for region in other_regions:
+            if _ranges_overlap(mailbox, region):
+                problems.append(
+                    f"{other} .data/.bss 0x{region[0]:x}-0x{region[1]:x} overwrites {owner} .noinit "
+                    f"0x{mailbox[0]:x}-0x{mailbox[1]:x}"
+                )
+        if _ranges_overlap(mailbox, layout[other]['stack']):
+            problems.append(
+                f"{other} worst-case stack reaches {owner} .noinit by "
+                f"{mailbox[1] - layout[other]['stack'][0]} bytes"
+            )
+
+    return {
+        'layout': layout,
+        'problems': problems,
+        'headroom': min(info['headroom'] for info in layout.values()),
+        # RAM, kas būtu nepieciešama, ja atmiņa tiktu sadalīta manuāli starp abiem attēliem
+        'split_requirement': sum(info['statics_size'] + info['heap'] + info['stack_usage'] for info in layout.values()),
+    }
+
+def resolve_ram_layout(build_artifact, ram_start=None, ram_size=None):
+    """
+    Nosaka iekšējās SRAM sākumu un izmēru. Norādītās vērtības tiek izmantotas kā ir,
+    trūkstošās tiek iegūtas no ierīces galvenes (RAMSTART, RAMEND).
+    Atgriež (ram_start, ram_size, ierīces atmiņa vai None).
+    """
+    memory = AVRCStackAnalyzer.for_artifact(build_artifact).get_device_memory()
+    if ram_start is None:
+        if memory:
+            ram_start = memory['ram_start']
+        else:
+            ram_start = 0x100
+            logger.warning(f"Could not read RAMSTART for {build_artifact.mcu_type}, assuming 0x{ram_start:x} (use --ram-start)")
+    if ram_size is None:
+        if memory:
+            ram_size = memory['ram_end'] + 1 - ram_start
+        else:
+            ram_size = 2048
+            logger.warning(f"Could not read RAMEND for {build_artifact.mcu_type}, assuming {ram_size} bytes (use -r)")
+    return ram_start, ram_size, memory
+
+def analyze_dual_image(bootloader_file, application_file, mcu_type="atmega328p", ram_size=None, ram_start=None,
+                       optimization="O0", bootloader_flags=None, application_flags=None, cache_dir=None,
+                       recursion_limits=None):
+    """
+    Analizē sāknēšanas ielādētāju un lietotni kopā ar kopīgu RAM uzskaiti.
+    Ja RAM sākums vai izmērs nav norādīts, tas tiek nolasīts no ierīces galvenes.
+    """
+    try:
+        cache = ArtifactCache(cache_dir) if cache_dir else None
+        images = {}
+        for role, input_file, flags in (('bootloader', bootloader_file, bootloader_flags),
+                                        ('application', application_file, application_flags)):
+            if is_image_file(input_file):
+                build_artifact = load_elf_program(input_file, mcu_type=mcu_type, cache=cache)
+            else:
+                build_artifact = build_program(
+                    input_file,
+                    mcu_type=mcu_type,
+                    optimization=optimization,
+                    compiler_flags=flags,
+                    cache=cache
+                )
+            build_artifact = with_recursion_limits(build_artifact, recursion_limits)
+            images[role] = run_stages(build_artifact, cache)
+
+        ram_start, ram_size, _ = resolve_ram_layout(build_artifact, ram_start, ram_size)
+        result = check_dual_image(images, ram_start, ram_size)
+
+        report = [
+            f"Dual Image Analysis: {os.path.basename(bootloader_file)} + {os.path.basename(application_file)}",
+            "=" * 60,
+            f"MCU Type: {mcu_type}",
+            f"RAM: 0x{ram_start:x}-0x{ram_start + ram_size - 1:x} ({ram_size} bytes)",
+            "",
+        ]
+        for role, info in result['layout'].items():
+            report.append(f"{role.capitalize()}:")
+            report.append("-" * 30)
+            report.append(f"Static Data (.data + .bss + .noinit): {info['statics_size']} bytes, ends at 0x{info['statics_end']:x}")
+            if info['noinit']:
+                report.append(f"Shared .noinit: 0x{info['noinit'][0]:x}-0x{info['noinit'][1] - 1:x}")
+            if info['heap']:
+                qualifier = " (lower bound, UNKNOWN)" if info['heap_unknown'] else ""
+                report.append(f"Heap: {info['heap']} bytes{qualifier}")
+            report.append(f"Maximum Stack Usage (with 10% safety margin): {info['stack_usage']} bytes")
+            report.append(f"Stack Region: 0x{info['stack'][0]:x}-0x{info['stack'][1] - 1:x}")
+            report.append(f"Headroom: {info['headroom']} bytes")
+            report.append("")
+
+        report.append("Combined Verdict:")
+        report.append("-" * 30)
+        for problem in result['problems']:
+            report.append(f"PROBLEM: {problem}")
+        verdict = "FAIL" if result['problems'] else "OK"
+        report.append(f"Product Headroom: {result['headroom']} bytes ({verdict})")
+        report.append(f"RAM needed with manual splitting: {result['split_requirement']} bytes")
+
+        return "\n".join(report)
+
+    except Exception as e:
+        logger.error(f"Error analyzing dual image: {e}")
+        logger.debug("Analysis traceback:", exc_info=True)
+        return f"Error: {e}"
+
+def check_xmem_placement(image, solution, ram_start, ram_size, external_start, external_size, source_content="",
+                         xram_end=None):
+    """
+    Pārbauda, vai sliktākā gadījuma steks (ar pārtraukumiem) pilnībā atrodas iekšējā SRAM, ņemot vērā
+    .data/.bss/.noinit un kaudzes izvietojumu iekšējā un ārējā (XMEM) atmiņā.
+    Ārējā atmiņa nedrīkst pārsniegt ierīces adresējamo apgabalu (XRAMEND).
+    Ja neietilpst, iesaka lielākos iekšējos .bss simbolus, ko pārvietot uz ārējo atmiņu.
+    """
+    internal = (ram_start, ram_start + ram_size)
+    external = (external_start, external_start + external_size)
+    headers = dict(image.section_headers)
+    symbols = dict(image.data_symbols)
+
+    def region_of(start):
+        if internal[0] <= start < internal[1]:
+            return 'internal'
+        if external[0] <= start < external[1]:
+            return 'external'
+        return 'unmapped'
+
+    # Statisko datu sekcijas un to atmiņas apgabals
+    placement = []
+    for name in ('.data', '.bss', '.noinit'):
+        addr, size = headers.get(name, (0, 0))
+        if size > 0:
+            placement.append((name, addr, addr + size, region_of(addr)))
+
+    # Kaudze: __malloc_heap_start no avota koda, citādi linkera simbols __heap_start
+    heap = dict(solution.heap) if solution.heap else None
+    heap_bound = heap['lower_bound'] if heap else 0
+    heap_match = re.search(r'__malloc_heap_start\s*=\s*\(\s*char\s*\*\s*\)\s*(0x[0-9a-fA-F]+|\d+)', source_content)
+    if heap_match:
+        heap_start = int(heap_match.group(1), 0)
+    elif '__heap_start' in symbols:
+        heap_start = symbols['__heap_start'][0]
+    else:
+        heap_start = max((end for _, _, end, _ in placement), default=ram_start)
+    if heap_bound:
+        placement.append(('heap', heap_start, heap_start + heap_bound, region_of(heap_start)))
+
+    # Steka virsotne: linkera simbols __stack (pēdējais baits), citādi iekšējās SRAM beigas
+    stack_top = symbols['__stack'][0] + 1 if '__stack' in symbols else internal[1]
+    stack = (stack_top - solution.max_stack_usage, stack_top)
+
+    problems = []
+    if xram_end is not None and external_size > 0 and external[1] > xram_end + 1:
+        problems.append(f"external SRAM 0x{external[0]:x}-0x{external[1] - 1:x} exceeds XRAMEND 0x{xram_end:x}")
+    # Neatrisinātas kaudzes alokācijas: izvietojums balstās tikai uz apakšējo robežu
+    if heap and (heap['unresolved'] or heap['bound'] is None):
+        unresolved = ", ".join(heap['unresolved'][:3]) + (", ..." if len(heap['unresolved']) > 3 else "")
+        problems.append(f"heap size is UNKNOWN ({unresolved}), placement uses the lower bound of {heap_bound} bytes")
+    for name, start, end, region in placement:
+        if region == 'unmapped' or region == 'external' and end > external[1] or region == 'internal' and end > internal[1]:
+            problems.append(f"{name} 0x{start:x}-0x{end:x} does not fit in the {region} memory region")
+    if region_of(stack_top - 1) != 'internal':
+        problems.append(f"stack top 0x{stack_top - 1:x} is not in internal SRAM")
+
+    # Iekšējā SRAM zem steka aizņemtā daļa
+    internal_used_end = max(
+        (end for _, start, end, region in placement if region == 'internal' and start < stack_top),
+        default=internal[0]
+    )
+    headroom = stack[0] - max(internal_used_end, internal[0])
+
+    suggestions = []
+    if headroom < 0:
+        # Lielākie iekšējie .bss simboli, līdz atbrīvots pietiekami daudz vietas
+        candidates = sorted(
+            ((name, size) for name, (addr, size, section) in symbols.items()
+             if section == '.bss' and size > 0 and region_of(addr) == 'internal'),
+            key=lambda item: item[1],
+            reverse=True
+        )
+        freed = 0
+        for name, size in candidates:
+            if freed >= -headroom:
+                break
+            suggestions.append((name, size))
+            freed += size
+        if freed < -headroom:
+            problems.append(f"moving all internal .bss symbols frees only {freed} of {-headroom} bytes")
+
+    return {
+        'internal': internal,
+        'external': external,
+        'placement': placement,
+        'stack': stack,
+        'headroom': headroom,
+        'suggestions': suggestions,
+        'problems': problems,
+    }
+
+def analyze_xmem(source_file, mcu_type="atmega2560", ram_size=None, ram_start=None, external_size=0, external_start=None,
+                 optimization="O0", extra_flags=None, cache_dir=None, recursion_limits=None):
+    """
+    Analizē steka izvietojumu iekšējā SRAM plātnēm ar ārējo SRAM (XMEM).
+    Ja iekšējās SRAM sākums vai izmērs nav norādīts, tas tiek nolasīts no ierīces galvenes.
+    """
+    try:
+        cache = ArtifactCache(cache_dir) if cache_dir else None
+        if is_image_file(source_file):
+            build_artifact = load_elf_program(source_file, mcu_type=mcu_type, cache=cache)
+        else:
+            build_artifact = build_program(
+                source_file,
+                mcu_type=mcu_type,
+                optimization=optimization,
+                compiler_flags=extra_flags,
+                cache=cache
+            )
+        build_artifact = with_recursion_limits(build_artifact, recursion_limits)
+        image, solution = run_stages(build_artifact, cache)
+        ram_start, ram_size, memory = resolve_ram_layout(build_artifact, ram_start, ram_size)
+
+        # Ārējā SRAM pēc noklusējuma sākas uzreiz aiz iekšējās (ATmega2560: 0x2200)
+        if external_start is None:
+            external_start = ram_start + ram_size
+        result = check_xmem_placement(
+            image, solution, ram_start, ram_size, external_start, external_size, build_artifact.source_content,
+            xram_end=memory['xram_end'] if memory else None
+        )
+
+        report = [
+            f"External SRAM Placement Analysis: {os.path.basename(source_file)}",
+            "=" * 60,
+            f"MCU Type: {mcu_type}",
+            f"Internal SRAM: 0x{result['internal'][0]:x}-0x{result['internal'][1] - 1:x} ({ram_size} bytes)",
+            f"External SRAM: 0x{result['external'][0]:x}-0x{result['external'][1] - 1:x} ({external_size} bytes)",
+            "",
+            "Placement:",
+            "-" * 30,
+        ]
+        for name, start, end, region in result['placement']:
+            report.append(f"{name}: 0x{start:x}-0x{end - 1:x} ({end - start} bytes, {region})")
+        report.append(f"Maximum Stack Usage (with 10% safety margin, including interrupts): {solution.max_stack_usage} bytes")
+        report.append(f"Stack Region: 0x{result['stack'][0]:x}-0x{result['stack'][1] - 1:x}")
+        report.append("")
+
+        report.append("Verdict:")
+        report.append("-" * 30)
+        for problem in result['problems']:
+            report.append(f"PROBLEM: {problem}")
+        if result['headroom'] >= 0:
+            report.append(f"Stack fits in internal SRAM (headroom {result['headroom']} bytes)")
+        else:
+            report.append(f"Stack does NOT fit in internal SRAM (short by {-result['headroom']} bytes)")
+            if result['suggestions']:
+                report.append("Suggested .bss symbols to move to external SRAM:")
+                for name, size in result['suggestions']:
+                    report.append(f"  {name}: {size} bytes")
+
+        return "\n".join(report)
+
     except Exception as e:
-        logger.error(f"Error analyzing stack usage: {e}")
-        import traceback
-        traceback.print_exc()
+        logger.error(f"Error analyzing external SRAM placement: {e}")
+        logger.debug("Analysis traceback:", exc_info=True)
         return f"Error: {e}"
 
+# Galvenā analīzes funkcija
+def analyze_stack(source_file, mcu_type="atmega328p", ram_size=2048, optimization="O0", extra_flags=None, cache_dir=None,
+                  breakdown=False, recursion_limits=None):
+    """Analizē steka izmantojumu AVR C sākuma failam vai nokompilētam attēlam (ELF, Intel HEX)."""
+    with trace_span('analyze_stack', file=os.path.basename(source_file)):
+        try:
+            cache = ArtifactCache(cache_dir) if cache_dir else None
+            
+            if is_image_file(source_file):
+                # Jau nokompilēts attēls (ELF, stripped ELF vai Intel HEX) bez kompilācijas
+                build_artifact = load_elf_program(source_file, mcu_type=mcu_type, cache=cache)
+            else:
+                # Kompilē kodu un iegūst steka lietošanas pārskatu no GCC
+                build_artifact = build_program(
+                    source_file,
+                    mcu_type=mcu_type,
+                    optimization=optimization,
+                    compiler_flags=extra_flags,
+                    cache=cache
+                )
+            
+            # Disamblē kodu un analizē statiskās steka lietojumu
+            build_artifact = with_recursion_limits(build_artifact, recursion_limits)
+            image, solution = run_stages(build_artifact, cache)
+            
+            # Ģenerē atskaiti
+            return render_report(build_artifact, image, solution, ram_size, breakdown=breakdown)
+            
+        except Exception as e:
+            logger.error(f"Error analyzing stack usage: {e}")
+            logger.debug("Analysis traceback:", exc_info=True)
+            return f"Error: {e}"
+
+def recursion_limit(value):
+    """Parsē --recursion-limit vērtību FUNC=N par (funkcija, dziļums)."""
+    func, separator, depth = value.rpartition('=')
+    if not separator or not func or not depth.isdigit() or int(depth) < 1:
+        raise argparse.ArgumentTypeError(f"expected FUNC=N with N >= 1, got '{value}'")
+    return func, int(depth)
+
 def main():
     parser = argparse.ArgumentParser(description="Analyze stack usage of AVR C programs")
-    parser.add_argument("source_file", help="C source file to analyze")
+    parser.add_argument("source_file", help="C source file, ELF or Intel HEX image to analyze (application file with --bootloader)")
     parser.add_argument("-m", "--mcu", default="atmega328p", help="MCU type (default: atmega328p)")
-    parser.add_argument("-r", "--ram", type=int, default=2048, help="RAM size in bytes (default: 2048)")
+    parser.add_argument("-r", "--ram", type=int, help="RAM size in bytes (default: 2048; with --bootloader or --xmem-size: from the device header)")
     parser.add_argument("-o", "--optimization", default="O0", help="Optimization level: O0 (none), O1 (basic), O2 (standard), O3 (aggressive), Os (size), Og (debug) (default: O0)")
     parser.add_argument("-l", "--log-level", default="warning", help="Logging level: debug, info, warning, error, critical (default: warning)")
     parser.add_argument("-c", "--compiler-flags", help="Additional GCC compiler flags")
+    parser.add_argument("--cache-dir", help="Directory for caching intermediate analysis artifacts")
+    parser.add_argument("-b", "--bootloader", help="Bootloader C or ELF file; analyzes it together with source_file as the application")
+    parser.add_argument("--bootloader-flags", help="Additional GCC compiler flags for the bootloader")
+    parser.add_argument("--trace", help="Write a Chrome trace-event JSON file with phase and subprocess timings")
+    parser.add_argument("--breakdown", action="store_true", help="Show worst-case stack breakdown by directory, library and source file")
+    parser.add_argument("--ram-start", type=lambda value: int(value, 0), help="First SRAM address, overrides RAMSTART from the device header")
+    parser.add_argument("--xmem-size", type=lambda value: int(value, 0), help="External SRAM size in bytes; checks that the stack stays in internal SRAM (-r)")
+    parser.add_argument("--xmem-start", type=lambda value: int(value, 0), help="First external SRAM address (default: right after internal SRAM)")
+    parser.add_argument("--recursion-limit", type=recursion_limit, action="append", default=[], metavar="FUNC=N",
+                        help="Recursion depth of FUNC, for images without source or depths not found in the source (repeatable)")
     
     args = parser.parse_args()
     
@@ -1591,17 +4246,67 @@ def main():
     # Parsē kompilatoru karogus
     extra_flags = args.compiler_flags.split() if args.compiler_flags else None
     
+    # Lietotāja norādītie rekursijas dziļumi
+    recursion_limits = dict(args.recursion_limit)
+    
+    # Ieslēdz trasēšanu
+    if args.trace:
+        enable_tracing()
+    
+    # Divu attēlu (sāknēšanas ielādētājs + lietotne) analīze
+    if args.bootloader:
+        bootloader_flags = args.bootloader_flags.split() if args.bootloader_flags else None
+        print(analyze_dual_image(
+            args.bootloader,
+            args.source_file,
+            mcu_type=mcu_type,
+            ram_size=args.ram,
+            ram_start=args.ram_start,
+            optimization=args.optimization,
+            bootloader_flags=bootloader_flags,
+            application_flags=extra_flags,
+            cache_dir=args.cache_dir,
+            recursion_limits=recursion_limits
+        ))
+        if args.trace:
+            tracer.write(args.trace)
+        return
+    
+    # Iekšējās un ārējās SRAM (XMEM) izvietojuma analīze
+    if args.xmem_size:
+        print(analyze_xmem(
+            args.source_file,
+            mcu_type=mcu_type,
+            ram_size=args.ram,
+            ram_start=args.ram_start,
+            external_size=args.xmem_size,
+            external_start=args.xmem_start,
+            optimization=args.optimization,
+            extra_flags=extra_flags,
+            cache_dir=args.cache_dir,
+            recursion_limits=recursion_limits
+        ))
+        if args.trace:
+            tracer.write(args.trace)
+        return
+    
     # Veic analīzi
     result = analyze_stack(
         args.source_file,
         mcu_type=mcu_type,
-        ram_size=args.ram,
+        ram_size=args.ram or 2048,
         optimization=args.optimization,
-        extra_flags=extra_flags
+        extra_flags=extra_flags,
+        cache_dir=args.cache_dir,
+        breakdown=args.breakdown,
+        recursion_limits=recursion_limits
     )
     
     # Izdrukā rezultātus
     print(result)
+    
+    if args.trace:
+        tracer.write(args.trace)
 
 if __name__ == "__main__":
     main()
\ No newline at end of file
@@ -0,0 +1,477 @@
+"""
+Salīdzina steka analīzes dzinējus savā starpā (diferenciālā testēšana).
+
+Katrs dzinējs saņem vienu un to pašu nokompilēto programmu, un tā rezultāti
+(funkciju steka izmantojums, izsaukumu šķautnes, rekursijas ierobežojumi un
+maksimālais steka patēriņš) tiek salīdzināti ar bāzes dzinēju (regex konveijeru).
+Tiek pārbaudīti gan repozitorija testa faili, gan nejauši ģenerētas programmas.
+Ja rezultāti atšķiras, ģenerētā programma tiek samazināta līdz minimālam
+piemēram, kas joprojām uzrāda atšķirību.
+
+Izmantošana:
+python3 differential_test.py
+python3 differential_test.py --random 1000 --seed 7 --engines regex,staged
+"""
+
+import argparse
+import glob
+import importlib.util
+import logging
+import os
+import random
+import re
+import sys
+import time
+
+ANALYZER_SCRIPT = "avr-stack-analyzer-static.py"
+
+
+def load_analyzer_module(path=ANALYZER_SCRIPT):
+    """Ielādē analizatora skriptu kā moduli (faila nosaukumā ir defises)."""
+    spec = importlib.util.spec_from_file_location("avr_stack_analyzer", path)
+    module = importlib.util.module_from_spec(spec)
+    # Reģistrē moduli, lai dzinēji un artefaktu klases būtu atrodamas pēc nosaukuma
+    sys.modules[spec.name] = module
+    spec.loader.exec_module(module)
+    return module
+
+
+# Reģistrēto dzinēju saraksts: nosaukums -> funkcija(analyzer) -> analīzes rezultāts
+ENGINES = {}
+
+
+def register_engine(name):
+    """Reģistrē analīzes dzinēju salīdzināšanai."""
+    def decorator(func):
+        ENGINES[name] = func
+        return func
+    return decorator
+
+
+@register_engine("regex")
+def run_regex_engine(analyzer):
+    """Esošais konveijers: .su faili, avr-objdump izvade un regulārās izteiksmes."""
+    gcc_stack_usage = analyzer.collect_stack_usage_reports()
+    asm_code = analyzer.disassemble_avr()
+    return analyzer.analyze_static_stack_usage(asm_code, gcc_stack_usage)
+
+
+@register_engine("staged")
+def run_staged_engine(analyzer):
+    """Bibliotēkas API posmi: load image, decode, graph, solve."""
+    module = sys.modules[type(analyzer).__module__]
+    build_artifact = module.artifact_from_analyzer(analyzer)
+    image = module.load_image(build_artifact)
+    decoded = module.decode_image(build_artifact, image)
+    graph_artifact = module.build_graph(build_artifact, image, decoded)
+    return module.solve_stack(build_artifact, graph_artifact).to_analysis()
+
+
+def normalize_result(analysis):
+    """Pārveido analīzes rezultātu salīdzināmā formā."""
+    call_edges = set()
+    for caller, callees in analysis['call_graph'].items():
+        for callee in callees:
+            call_edges.add((caller, callee))
+
+    return {
+        'function_usage': dict(analysis['function_usage']),
+        'call_edges': call_edges,
+        'recursion_limits': dict(analysis['recursion_limits']),
+        'worst_case': analysis['raw_max_usage'],
+    }
+
+
+def diff_results(baseline, candidate):
+    """Atgriež atšķirību sarakstu starp diviem normalizētiem rezultātiem."""
+    differences = []
+
+    # Kļūdas salīdzina kā tekstu
+    if 'error' in baseline or 'error' in candidate:
+        if baseline.get('error') != candidate.get('error'):
+            differences.append(f"error: {baseline.get('error')!r} != {candidate.get('error')!r}")
+        return differences
+
+    for key in ('function_usage', 'recursion_limits'):
+        base_map = baseline[key]
+        cand_map = candidate[key]
+        for func in sorted(set(base_map) | set(cand_map)):
+            if base_map.get(func) != cand_map.get(func):
+                differences.append(f"{key}[{func}]: {base_map.get(func)} != {cand_map.get(func)}")
+
+    for edge in sorted(baseline['call_edges'] - candidate['call_edges']):
+        differences.append(f"call edge missing: {edge[0]} -> {edge[1]}")
+    for edge in sorted(candidate['call_edges'] - baseline['call_edges']):
+        differences.append(f"call edge extra: {edge[0]} -> {edge[1]}")
+
+    if baseline['worst_case'] != candidate['worst_case']:
+        differences.append(f"worst_case: {baseline['worst_case']} != {candidate['worst_case']}")
+
+    return differences
+
+
+def difference_key(line):
+    """Atšķirības lauks bez konkrētās funkcijas vai šķautnes: 'function_usage[f]: 4 != 6' -> 'function_usage'."""
+    return re.split(r'[\[:]', line, maxsplit=1)[0]
+
+
+class RandomProgram:
+    """Nejauši ģenerētas C programmas modelis, ko var renderēt un samazināt."""
+
+    RECURSION_PATTERNS = ("-", "/", ">>")
+
+    def __init__(self, functions, main_calls, table=None):
+        # functions: nosaukums -> {'locals': int, 'calls': [nosaukumi], 'recursion': (op, factor, initial) vai None}
+        self.functions = functions
+        self.main_calls = main_calls
+        # Funkciju rādītāju tabula (icall), saraksts ar funkciju nosaukumiem
+        self.table = table or []
+
+    @classmethod
+    def generate(cls, rng, max_functions=8):
+        """Ģenerē nejaušu programmu bez cikliem izsaukumu grafā (izņemot pašrekursiju)."""
+        count = rng.randint(1, max_functions)
+        names = [f"f{i}" for i in range(count)]
+        functions = {}
+
+        for index, name in enumerate(names):
+            # Izsauc tikai funkcijas ar lielāku indeksu, lai grafs būtu aciklisks
+            later = names[index + 1:]
+            calls = rng.sample(later, rng.randint(0, min(3, len(later)))) if later else []
+
+            recursion = None
+            if rng.random() < 0.2:
+                op = rng.choice(cls.RECURSION_PATTERNS)
+                factor = rng.randint(1, 3) if op == "-" else rng.randint(1, 2) if op == ">>" else rng.randint(2, 4)
+                recursion = (op, factor, rng.randint(2, 40))
+
+            functions[name] = {
+                'locals': rng.choice([0, 0, 1, 2, 4, 8, 16, 32]),
+                'calls': calls,
+                'recursion': recursion,
+            }
+
+        called = {callee for spec in functions.values() for callee in spec['calls']}
+        main_calls = [name for name in names if name not in called or rng.random() < 0.3]
+
+        table = []
+        if count >= 2 and rng.random() < 0.2:
+            table = rng.sample(names, 2)
+
+        return cls(functions, main_calls, table)
+
+    def copy(self):
+        return RandomProgram(
+            {name: {'locals': spec['locals'], 'calls': list(spec['calls']), 'recursion': spec['recursion']}
+             for name, spec in self.functions.items()},
+            list(self.main_calls),
+            list(self.table)
+        )
+
+    def render(self):
+        """Izveido C pirmkodu no modeļa."""
+        lines = ["#include <avr/io.h>", "#include <stdint.h>", ""]
+
+        for name in self.functions:
+            lines.append(f"uint8_t {name}(uint8_t n);")
+        lines.append("")
+
+        if self.table:
+            lines.append("typedef uint8_t (*fn_ptr)(uint8_t);")
+            lines.append(f"fn_ptr table[{len(self.table)}] = {{ {', '.join(self.table)} }};")
+            lines.append("")
+
+        for name, spec in self.functions.items():
+            lines.append(f"uint8_t {name}(uint8_t n) {{")
+            if spec['locals']:
+                lines.append(f"    volatile uint8_t buf[{spec['locals']}];")
+                lines.append("    buf[0] = n;")
+            if spec['recursion']:
+                op, factor, _ = spec['recursion']
+                lines.append("    if (n <= 1) {")
+                lines.append("        return n;")
+                lines.append("    }")
+                lines.append(f"    n = {name}(n {op} {factor});")
+            for callee in spec['calls']:
+                lines.append(f"    n += {callee}(n);")
+            lines.append("    PORTB = n;")
+            lines.append("    return n;")
+            lines.append("}")
+            lines.append("")
+
+        lines.append("int main(void) {")
+        lines.append("    uint8_t value = 0;")
+        for name in self.main_calls:
+            spec = self.functions[name]
+            initial = spec['recursion'][2] if spec['recursion'] else 3
+            lines.append(f"    value += {name}({initial});")
+        if self.table:
+            lines.append(f"    value += table[PINB % {len(self.table)}](value);")
+        lines.append("    PORTB = value;")
+        lines.append("    return 0;")
+        lines.append("}")
+        lines.append("")
+
+        return "\n".join(lines)
+
+    def shrink_candidates(self):
+        """Ģenerē mazākus programmas variantus (viens solis)."""
+        # Funkcijas izņemšana kopā ar visiem tās izsaukumiem
+        for name in list(self.functions):
+            if len(self.functions) == 1:
+                break
+            candidate = self.copy()
+            del candidate.functions[name]
+            for spec in candidate.functions.values():
+                spec['calls'] = [callee for callee in spec['calls'] if callee != name]
+            candidate.main_calls = [callee for callee in candidate.main_calls if callee != name]
+            candidate.table = [callee for callee in candidate.table if callee != name]
+            if len(candidate.table) < 2:
+                candidate.table = []
+            yield candidate
+
+        # Funkciju rādītāju tabulas izņemšana
+        if self.table:
+            candidate = self.copy()
+            candidate.table = []
+            yield candidate
+
+        # Atsevišķu izsaukumu izņemšana
+        for name, spec in self.functions.items():
+            for callee in spec['calls']:
+                candidate = self.copy()
+                candidate.functions[name]['calls'].remove(callee)
+                yield candidate
+
+        for callee in self.main_calls:
+            candidate = self.copy()
+            candidate.main_calls.remove(callee)
+            yield candidate
+
+        # Rekursijas un lokālo mainīgo vienkāršošana
+        for name, spec in self.functions.items():
+            if spec['recursion']:
+                candidate = self.copy()
+                candidate.functions[name]['recursion'] = None
+                yield candidate
+            if spec['locals']:
+                candidate = self.copy()
+                candidate.functions[name]['locals'] = spec['locals'] // 2
+                yield candidate
+
+
+class DifferentialHarness:
+    def __init__(self, module, engines, mcu="atmega328p", ram_size=2048, optimization="O0", work_dir="diff_repro"):
+        self.module = module
+        self.engines = engines
+        self.mcu = mcu
+        self.ram_size = ram_size
+        self.optimization = optimization
+        self.work_dir = work_dir
+        self.timings = {name: 0.0 for name in engines}
+        self.mismatches = []
+        self.checked = 0
+        self.skipped = 0
+        # Programmas, kurās visi dzinēji beidzās ar kļūdu (pārbaudīts tikai kļūdas ceļš)
+        self.error_only = 0
+
+        os.makedirs(self.work_dir, exist_ok=True)
+
+    def run_engines(self, source_file):
+        """Nokompilē programmu vienreiz un palaiž visus dzinējus. Atgriež None, ja kompilācija neizdodas."""
+        analyzer = self.module.AVRCStackAnalyzer(
+            source_file,
+            mcu_type=self.mcu,
+            ram_size=self.ram_size,
+            optimization=self.optimization
+        )
+        try:
+            analyzer.compile_c_code()
+        except RuntimeError:
+            return None
+
+        results = {}
+        timings = {}
+        for name in self.engines:
+            start = time.perf_counter()
+            try:
+                results[name] = normalize_result(ENGINES[name](analyzer))
+            except Exception as e:
+                results[name] = {'error': str(e)}
+            timings[name] = time.perf_counter() - start
+
+        return results, timings
+
+    def compare(self, source_file):
+        """
+        Atgriež (atšķirības pa dzinējiem, laiki, vai visi dzinēji beidzās ar kļūdu)
+        vai None, ja programmu nevar nokompilēt.
+        """
+        outcome = self.run_engines(source_file)
+        if outcome is None:
+            return None
+
+        results, timings = outcome
+        baseline_name = self.engines[0]
+        differences = {}
+        for name in self.engines[1:]:
+            engine_diff = diff_results(results[baseline_name], results[name])
+            if engine_diff:
+                differences[name] = engine_diff
+        error_only = all('error' in result for result in results.values())
+        return differences, timings, error_only
+
+    def record(self, label, differences, timings, error_only=False):
+        self.checked += 1
+        for name, elapsed in timings.items():
+            self.timings[name] += elapsed
+        if differences:
+            self.mismatches.append((label, differences, timings))
+        elif error_only:
+            self.error_only += 1
+
+    def check_file(self, source_file):
+        """Pārbauda vienu esošu C failu."""
+        outcome = self.compare(source_file)
+        if outcome is None:
+            print(f"{os.path.basename(source_file)}: compilation failed, skipped")
+            self.skipped += 1
+            return
+        differences, timings, error_only = outcome
+        self.record(os.path.basename(source_file), differences, timings, error_only)
+        self.print_line(os.path.basename(source_file), differences, timings, error_only)
+
+    def write_program(self, program, name):
+        path = os.path.join(self.work_dir, name)
+        with open(path, 'w') as f:
+            f.write(program.render())
+        return path
+
+    def check_random(self, program, index):
+        """Pārbauda vienu nejaušu programmu un samazina to, ja atrasta atšķirība."""
+        path = self.write_program(program, f"random_{index}.c")
+        outcome = self.compare(path)
+        if outcome is None:
+            self.skipped += 1
+            os.remove(path)
+            return
+
+        differences, timings, error_only = outcome
+        if not differences:
+            self.record(f"random #{index}", differences, timings, error_only)
+            os.remove(path)
+            return
+
+        reduced, differences, timings = self.shrink(program, index, differences, timings)
+        repro_path = self.write_program(reduced, f"repro_{index}.c")
+        os.remove(path)
+        self.record(f"random #{index} (reproducer: {repro_path})", differences, timings)
+        self.print_line(f"random #{index}", differences, timings)
+
+    def shrink(self, program, index, differences, timings):
+        """
+        Samazina programmu, kamēr atšķirība joprojām saglabājas (greedy delta debugging).
+        differences un timings ir sākotnējās programmas salīdzinājuma rezultāts.
+        Kandidāts tiek pieņemts tikai tad, ja tam ir tā pati atšķirība (dzinējs un lauks),
+        lai samazinātais piemērs nepārietu uz citu atšķirību.
+        """
+        path = os.path.join(self.work_dir, f"shrink_{index}.c")
+        current = program
+        engine = next(iter(differences))
+        field = difference_key(differences[engine][0])
+
+        progress = True
+        while progress:
+            progress = False
+            for candidate in current.shrink_candidates():
+                with open(path, 'w') as f:
+                    f.write(candidate.render())
+                outcome = self.compare(path)
+                if outcome is None or field not in {difference_key(line) for line in outcome[0].get(engine, [])}:
+                    continue
+                current = candidate
+                differences, timings, _ = outcome
+                progress = True
+                break
+
+        if os.path.exists(path):
+            os.remove(path)
+        return current, differences, timings
+
+    def print_line(self, label, differences, timings, error_only=False):
+        timing_str = ", ".join(f"{name} {elapsed * 1000:.1f} ms" for name, elapsed in timings.items())
+        status = "MISMATCH" if differences else "ok (error)" if error_only else "ok"
+        print(f"{label:<30} {status:<10} [{timing_str}]")
+        for name, engine_diff in differences.items():
+            for line in engine_diff:
+                print(f"    {name}: {line}")
+
+    def print_summary(self):
+        print("\nDIFFERENTIAL TEST SUMMARY")
+        print("=" * 60)
+        print(f"Programs compared: {self.checked}")
+        print(f"Programs skipped (compilation failed): {self.skipped}")
+        print(f"Programs with mismatches: {len(self.mismatches)}")
+        print(f"Programs where all engines failed (error path only): {self.error_only}")
+        print("\nTotal time per engine:")
+        for name, elapsed in self.timings.items():
+            print(f"  {name:<15} {elapsed:.3f} s")
+
+        if self.mismatches:
+            print("\nMISMATCHES:")
+            print("-" * 60)
+            for label, differences, timings in self.mismatches:
+                timing_str = ", ".join(f"{name} {elapsed * 1000:.1f} ms" for name, elapsed in timings.items())
+                print(f"{label} [{timing_str}]")
+                for name, engine_diff in differences.items():
+                    for line in engine_diff:
+                        print(f"    {name}: {line}")
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Compare stack analysis engines on test and random programs")
+    parser.add_argument("--engines", default=None, help="Comma-separated engine list, first one is the baseline (default: all registered)")
+    parser.add_argument("--random", type=int, default=2000, help="Number of random programs to generate (default: 2000)")
+    parser.add_argument("--seed", type=int, default=1, help="Random seed (default: 1)")
+    parser.add_argument("--directory", default=".", help="Directory with C test programs (default: .)")
+    parser.add_argument("--work-dir", default="diff_repro", help="Directory for generated programs and reproducers (default: diff_repro)")
+    parser.add_argument("-m", "--mcu", default="atmega328p", help="MCU type (default: atmega328p)")
+    parser.add_argument("-r", "--ram", type=int, default=2048, help="RAM size in bytes (default: 2048)")
+    parser.add_argument("-o", "--optimization", default="O0", help="Optimization level (default: O0)")
+    args = parser.parse_args()
+
+    # Analizatora žurnālošana tikai kļūdām, lai izvade būtu pārskatāma
+    logging.basicConfig(level=logging.ERROR)
+
+    module = load_analyzer_module()
+
+    engines = args.engines.split(",") if args.engines else list(ENGINES)
+    unknown = [name for name in engines if name not in ENGINES]
+    if unknown:
+        print(f"Error: Unknown engines: {', '.join(unknown)}. Available: {', '.join(ENGINES)}")
+        sys.exit(1)
+    if len(engines) < 2:
+        print(f"Note: only one engine ({engines[0]}) selected, reporting timings without comparison")
+
+    harness = DifferentialHarness(
+        module, engines,
+        mcu=args.mcu, ram_size=args.ram, optimization=args.optimization,
+        work_dir=args.work_dir
+    )
+
+    print(f"Baseline engine: {engines[0]}")
+    print("=" * 60)
+
+    for c_file in sorted(glob.glob(os.path.join(args.directory, "*.c"))):
+        harness.check_file(c_file)
+
+    rng = random.Random(args.seed)
+    for index in range(args.random):
+        harness.check_random(RandomProgram.generate(rng), index)
+
+    harness.print_summary()
+    sys.exit(1 if harness.mismatches else 0)
+
+
+if __name__ == "__main__":
+    main()
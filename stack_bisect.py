@@ -0,0 +1,327 @@
+"""
+Atrod pirmo git revīziju, kurā sliktākā gadījuma steka izmantojums pārsniedz budžetu.
+
+Revīzijas starp labo (good) un slikto (bad) revīziju tiek izrakstītas atsevišķos
+git worktree un analizētas paralēli atsevišķos procesos: katrā solī tiek pārbaudīti
+k kandidāti (k-ārā meklēšana, k = darba procesu skaits), tāpēc intervāls sarūk k+1 reizes.
+Katras revīzijas rezultāts tiek kešots pēc commit sha, konfigurācijas un analizatora
+versijas, tāpēc atkārtota meklēšana (piem., ar citu slieksni) neko nepārkompilē.
+Izlaistas revīzijas tiek kešotas tikai tad, ja kļūda ir noteikta (kompilācijas kļūda,
+avota faila nav šajā revīzijā); pārejošas kļūdas nākamajā palaišanā tiek mēģinātas atkal.
+
+Izmantošana:
+python3 stack_bisect.py v1.2 HEAD program.c --threshold 512
+python3 stack_bisect.py good_sha bad_sha src/main.c --threshold 1800 -m atmega2560 -j 8
+"""
+
+import argparse
+import hashlib
+import importlib.util
+import json
+import logging
+import os
+import shutil
+import subprocess
+import sys
+import tempfile
+from concurrent.futures import ProcessPoolExecutor
+
+ANALYZER_SCRIPT = os.path.join(os.path.dirname(os.path.abspath(__file__)), "avr-stack-analyzer-static.py")
+
+
+def load_analyzer_module(path=ANALYZER_SCRIPT):
+    """Ielādē analizatora skriptu kā moduli (faila nosaukumā ir defises)."""
+    spec = importlib.util.spec_from_file_location("avr_stack_analyzer", path)
+    module = importlib.util.module_from_spec(spec)
+    sys.modules[spec.name] = module
+    spec.loader.exec_module(module)
+    return module
+
+
+# Analizatora modulis darba procesā (ielādēts vienreiz katrā procesā)
+_worker_module = None
+
+
+def init_worker():
+    """Darba procesa inicializācija: analizatora žurnālošana tikai kļūdām."""
+    logging.basicConfig(level=logging.ERROR)
+
+
+def analyze_worktree(source_path, mcu, optimization, compiler_flags, cache_dir):
+    """
+    Nokompilē un analizē izrakstītās revīzijas avota failu darba procesā.
+    Kļūdas tiek atgrieztas kā 'skip'; 'deterministic' norāda, vai tā atkārtosies ar to pašu revīziju.
+    """
+    global _worker_module
+    try:
+        if _worker_module is None:
+            _worker_module = load_analyzer_module()
+        cache = _worker_module.ArtifactCache(cache_dir) if cache_dir else None
+        build_artifact = _worker_module.build_program(
+            source_path,
+            mcu_type=mcu,
+            optimization=optimization,
+            compiler_flags=compiler_flags,
+            cache=cache
+        )
+        _, solution = _worker_module.run_stages(build_artifact, cache)
+        return {
+            'status': 'good',
+            'max_stack_usage': solution.max_stack_usage,
+            'raw_max_usage': solution.raw_max_usage,
+            'function_usage': dict(solution.function_usage)
+        }
+    except Exception as e:
+        logging.debug("Analysis traceback:", exc_info=True)
+        deterministic = isinstance(e, FileNotFoundError) or str(e).startswith("Compilation failed")
+        return {'status': 'skip', 'error': str(e), 'deterministic': deterministic}
+
+
+def positive_int(value):
+    """argparse tips veseliem skaitļiem >= 1."""
+    number = int(value)
+    if number < 1:
+        raise argparse.ArgumentTypeError(f"must be at least 1, got {value}")
+    return number
+
+
+def git(repo, *args):
+    """Izpilda git komandu repozitorijā un atgriež izvadi."""
+    result = subprocess.run(["git", "-C", repo, *args], capture_output=True, text=True)
+    if result.returncode != 0:
+        raise RuntimeError(f"git {' '.join(args)} failed: {result.stderr.strip()}")
+    return result.stdout.strip()
+
+
+class StackBisect:
+    def __init__(self, module, repo, source_file, threshold, mcu="atmega328p", optimization="O0",
+                 compiler_flags=None, jobs=None, cache_file=".stack_bisect_cache.json", cache_dir=None):
+        self.module = module
+        self.repo = git(repo, "rev-parse", "--show-toplevel")
+        self.source_file = source_file
+        self.threshold = threshold
+        self.mcu = mcu
+        self.optimization = optimization
+        self.compiler_flags = compiler_flags or []
+        self.jobs = jobs or os.cpu_count() or 1
+        self.cache_file = cache_file
+        # Artefaktu keša būvēšanas atslēga ietver visu iekļauto galvenes failu saturu,
+        # tāpēc revīzija, kas maina tikai galveni, neizmanto citas revīzijas būvējumu
+        self.cache_dir = os.path.abspath(cache_dir) if cache_dir else None
+
+        # Revīziju rezultātu kešs: {sha:konfigurācija -> rezultāts}
+        self.results = {}
+        if cache_file and os.path.exists(cache_file):
+            with open(cache_file, 'r') as f:
+                self.results = json.load(f)
+        self.worktree_base = tempfile.mkdtemp(prefix="stack_bisect_")
+
+    def config_key(self, sha):
+        """Keša atslēga: commit sha, analīzes konfigurācija un analizatora versija."""
+        config = json.dumps([
+            self.source_file, self.mcu, self.optimization, self.compiler_flags,
+            self.module.ARTIFACT_SCHEMA_VERSION, self.module.ANALYZER_DIGEST
+        ])
+        return f"{sha}:{hashlib.sha256(config.encode('utf-8')).hexdigest()[:16]}"
+
+    def revisions(self, good, bad):
+        """Atgriež revīziju sarakstu no good līdz bad (ieskaitot abas) hronoloģiskā secībā."""
+        good_sha = git(self.repo, "rev-parse", "--verify", f"{good}^{{commit}}")
+        bad_sha = git(self.repo, "rev-parse", "--verify", f"{bad}^{{commit}}")
+        between = git(self.repo, "rev-list", "--ancestry-path", "--reverse", f"{good_sha}..{bad_sha}").split()
+        if not between:
+            raise RuntimeError(f"{bad} is not a descendant of {good}")
+        return [good_sha] + between
+
+    def evaluate(self, executor, shas):
+        """
+        Atgriež revīziju rezultātus no keša vai tās analizē paralēli darba procesos.
+        Worktree tiek izveidoti un noņemti galvenajā procesā, jo git maina kopīgos .git datus.
+        Neizdevusies revīzija tiek izlaista (skip).
+        """
+        results = {sha: self.results.get(self.config_key(sha)) for sha in shas}
+        worktrees = {}
+        futures = {}
+        try:
+            for sha in shas:
+                if results[sha] is not None:
+                    continue
+                worktree = os.path.join(self.worktree_base, sha[:12])
+                try:
+                    git(self.repo, "worktree", "add", "--detach", worktree, sha)
+                except RuntimeError as e:
+                    results[sha] = {'status': 'skip', 'error': str(e)}
+                    continue
+                worktrees[sha] = worktree
+                # Relatīvie ceļi karogos attiecas uz revīzijas worktree, nevis uz pašreizējo direktoriju,
+                # citādi visas revīzijas tiktu kompilētas ar pašreizējā izraksta galvenes failiem
+                futures[sha] = executor.submit(
+                    analyze_worktree, os.path.join(worktree, self.source_file),
+                    self.mcu, self.optimization, self.module.absolute_path_flags(self.compiler_flags, worktree),
+                    self.cache_dir
+                )
+            for sha, future in futures.items():
+                try:
+                    results[sha] = future.result()
+                except Exception as e:
+                    logging.debug("Analysis traceback:", exc_info=True)
+                    results[sha] = {'status': 'skip', 'error': str(e)}
+                # Pārejošas kļūdas (worktree, rīki, darba procesa kļūme) netiek kešotas
+                if results[sha]['status'] != 'skip' or results[sha].get('deterministic'):
+                    self.results[self.config_key(sha)] = results[sha]
+        finally:
+            for worktree in worktrees.values():
+                try:
+                    git(self.repo, "worktree", "remove", "--force", worktree)
+                except RuntimeError as e:
+                    logging.warning(f"Could not remove worktree {worktree}: {e}")
+
+        evaluated = []
+        for sha in shas:
+            result = dict(results[sha])
+            # Slieksnis nav daļa no keša atslēgas, tāpēc statuss tiek pārrēķināts
+            if result['status'] != 'skip':
+                result['status'] = 'bad' if result['max_stack_usage'] > self.threshold else 'good'
+            evaluated.append(result)
+        return evaluated
+
+    def print_result(self, sha, result):
+        if result['status'] == 'skip':
+            print(f"  {sha[:10]}: skip ({result['error']})")
+        else:
+            print(f"  {sha[:10]}: {result['status']} ({result['max_stack_usage']} bytes)")
+
+    def save_cache(self):
+        if self.cache_file:
+            with open(self.cache_file, 'w') as f:
+                json.dump(self.results, f, indent=1)
+
+    def probes(self, revisions, low, high, results):
+        """Izvēlas līdz k neanalizētām revīzijām, vienmērīgi izkliedētām intervālā (low, high)."""
+        inside = [index for index in range(low + 1, high) if revisions[index] not in results]
+        if len(inside) <= self.jobs:
+            return inside
+        step = len(inside) / (self.jobs + 1)
+        return sorted({inside[int(step * (i + 1))] for i in range(self.jobs)})
+
+    def run(self, good, bad):
+        """K-ārā meklēšana. Atgriež (pēdējā labā revīzija, pirmā sliktā revīzija, izlaistās revīzijas, rezultāti)."""
+        revisions = self.revisions(good, bad)
+        print(f"Bisecting {len(revisions) - 1} commits with {self.jobs} parallel jobs "
+              f"(threshold {self.threshold} bytes)")
+
+        results = {}
+        with ProcessPoolExecutor(max_workers=self.jobs, initializer=init_worker) as executor:
+            # Robežu pārbaude
+            for sha, result in zip((revisions[0], revisions[-1]),
+                                   self.evaluate(executor, [revisions[0], revisions[-1]])):
+                results[sha] = result
+                self.print_result(sha, result)
+            for name, sha, expected in ((good, revisions[0], 'good'), (bad, revisions[-1], 'bad')):
+                if results[sha]['status'] != expected:
+                    detail = results[sha].get('error') or f"{results[sha]['max_stack_usage']} bytes"
+                    raise RuntimeError(f"Revision {name} is not {expected} at threshold {self.threshold} bytes ({detail})")
+
+            low, high = 0, len(revisions) - 1
+            while True:
+                candidates = self.probes(revisions, low, high, results)
+                if not candidates:
+                    break
+                print(f"Testing {len(candidates)} of {high - low - 1} remaining commits:")
+                for index, result in zip(candidates, self.evaluate(executor, [revisions[i] for i in candidates])):
+                    results[revisions[index]] = result
+                    self.print_result(revisions[index], result)
+
+                # Pirmā sliktā kandidāta pozīcija nosaka jauno augšējo robežu,
+                # pēdējā labā pirms tās - apakšējo
+                for index in candidates:
+                    status = results[revisions[index]]['status']
+                    if status == 'good':
+                        low = index
+                    elif status == 'bad':
+                        high = index
+                        break
+                self.save_cache()
+
+        skipped = [revisions[index] for index in range(low + 1, high)
+                   if results.get(revisions[index], {}).get('status') == 'skip']
+        return revisions[low], revisions[high], skipped, results
+
+    def report(self, last_good, first_bad, skipped, results):
+        """Izdrukā pirmo slikto revīziju un funkciju steka izmantojuma izmaiņas."""
+        good_result = results[last_good]
+        bad_result = results[first_bad]
+
+        print("\nSTACK BISECT RESULT")
+        print("=" * 60)
+        if skipped:
+            print(f"First bad commit is one of {len(skipped) + 1} commits (some could not be analyzed):")
+            for sha in skipped:
+                print(f"  {git(self.repo, 'log', '-1', '--format=%h %s', sha)} (skipped)")
+        print(f"First bad commit: {git(self.repo, 'log', '-1', '--format=%h %an %s', first_bad)}")
+        print(f"Last good commit: {git(self.repo, 'log', '-1', '--format=%h %s', last_good)}")
+        print(f"Maximum Stack Usage: {good_result['max_stack_usage']} -> {bad_result['max_stack_usage']} bytes "
+              f"(threshold {self.threshold} bytes)")
+
+        print("\nPer-function stack usage changes:")
+        print("-" * 60)
+        good_usage = good_result['function_usage']
+        bad_usage = bad_result['function_usage']
+        changes = []
+        for func in sorted(set(good_usage) | set(bad_usage)):
+            before, after = good_usage.get(func), bad_usage.get(func)
+            if before != after:
+                changes.append((func, before, after, (after or 0) - (before or 0)))
+        changes.sort(key=lambda change: abs(change[3]), reverse=True)
+        for func, before, after, delta in changes:
+            if before is None:
+                print(f"  {func}: added, {after} bytes")
+            elif after is None:
+                print(f"  {func}: removed (was {before} bytes)")
+            else:
+                print(f"  {func}: {before} -> {after} bytes ({delta:+d})")
+        if not changes:
+            print("  (no per-function changes, the worst path changed through the call graph)")
+
+    def cleanup(self):
+        shutil.rmtree(self.worktree_base, ignore_errors=True)
+        git(self.repo, "worktree", "prune")
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Find the first commit where worst-case stack usage exceeds a threshold")
+    parser.add_argument("good", help="Revision known to be within the stack budget")
+    parser.add_argument("bad", help="Revision known to exceed the stack budget")
+    parser.add_argument("source_file", help="C source file to analyze, relative to the repository root")
+    parser.add_argument("-t", "--threshold", type=int, required=True, help="Stack budget in bytes (maximum stack usage with safety margin)")
+    parser.add_argument("-m", "--mcu", default="atmega328p", help="MCU type (default: atmega328p)")
+    parser.add_argument("-o", "--optimization", default="O0", help="Optimization level (default: O0)")
+    parser.add_argument("-c", "--compiler-flags", help="Additional GCC compiler flags; relative -I/-include paths are relative to the repository root")
+    parser.add_argument("-j", "--jobs", type=positive_int, default=None, help="Number of revisions analyzed in parallel processes (default: CPU count)")
+    parser.add_argument("--repo", default=".", help="Git repository (default: .)")
+    parser.add_argument("--cache-file", default=".stack_bisect_cache.json", help="Per-revision result cache (default: .stack_bisect_cache.json)")
+    parser.add_argument("--cache-dir", help="Directory for caching intermediate analysis artifacts")
+    args = parser.parse_args()
+
+    # Analizatora žurnālošana tikai kļūdām, lai izvade būtu pārskatāma
+    logging.basicConfig(level=logging.ERROR)
+
+    bisect = StackBisect(
+        load_analyzer_module(), args.repo, args.source_file, args.threshold,
+        mcu=args.mcu.lower(), optimization=args.optimization,
+        compiler_flags=args.compiler_flags.split() if args.compiler_flags else None,
+        jobs=args.jobs, cache_file=args.cache_file, cache_dir=args.cache_dir
+    )
+    try:
+        last_good, first_bad, skipped, results = bisect.run(args.good, args.bad)
+        bisect.report(last_good, first_bad, skipped, results)
+    except RuntimeError as e:
+        print(f"Error: {e}")
+        sys.exit(1)
+    finally:
+        bisect.save_cache()
+        bisect.cleanup()
+
+
+if __name__ == "__main__":
+    main()
@@ -7,11 +7,26 @@ import os
 import glob
 import re
 import sys
+import json
+import time
+import tempfile
+import threading
+import argparse
+from concurrent.futures import ThreadPoolExecutor
 
 class BatchStackAnalyzer:
-    def __init__(self, analyzer_script="avr-stack-analyzer-static.py"):
+    def __init__(self, analyzer_script="avr-stack-analyzer-static.py", jobs=1, trace_file=None, cache_dir=None):
         self.analyzer_script = analyzer_script
         self.results = []
+        self.jobs = jobs
+        self.trace_file = trace_file
+        self.cache_dir = cache_dir
+        
+        # Chrome trace-event notikumi (katram darba pavedienam savs tid)
+        self.trace_events = []
+        self.trace_lock = threading.Lock()
+        self.worker_ids = threading.local()
+        self.next_worker_id = 0
         
         # Pārbauda vai analizatora skripts eksistē
         if not os.path.exists(analyzer_script):
@@ -31,6 +46,57 @@ class BatchStackAnalyzer:
         
         return sorted(c_files)
     
+    def worker_id(self):
+        """Atgriež pašreizējā darba pavediena numuru (1, 2, ...)"""
+        if not hasattr(self.worker_ids, 'value'):
+            with self.trace_lock:
+                self.next_worker_id += 1
+                self.worker_ids.value = self.next_worker_id
+        return self.worker_ids.value
+    
+    def trace_event(self, phase, name, args=None, timestamp=None):
+        """Pievieno trace notikumu pašreizējā darba pavediena joslā"""
+        event = {
+            'name': name,
+            'cat': 'batch',
+            'ph': phase,
+            'ts': timestamp if timestamp is not None else time.time_ns() // 1000,
+            'pid': os.getpid(),
+            'tid': self.worker_id(),
+            'args': args or {}
+        }
+        with self.trace_lock:
+            self.trace_events.append(event)
+    
+    def merge_child_trace(self, child_trace):
+        """Pievieno analizatora procesa trace notikumus pašreizējā darba pavediena joslā"""
+        if not os.path.exists(child_trace):
+            return
+        if os.path.getsize(child_trace) == 0:
+            # Analizators beidza darbu, neierakstot trace failu
+            os.remove(child_trace)
+            return
+        with open(child_trace, 'r') as f:
+            events = json.load(f).get('traceEvents', [])
+        os.remove(child_trace)
+        
+        worker = self.worker_id()
+        for event in events:
+            event['pid'] = os.getpid()
+            event['tid'] = worker
+        with self.trace_lock:
+            self.trace_events.extend(events)
+    
+    def write_trace(self):
+        """Ieraksta apvienoto trace failu (atverams Perfetto vai chrome://tracing)"""
+        metadata = [
+            {'name': 'thread_name', 'ph': 'M', 'pid': os.getpid(), 'tid': worker, 'args': {'name': f"worker {worker}"}}
+            for worker in range(1, self.next_worker_id + 1)
+        ]
+        with open(self.trace_file, 'w') as f:
+            json.dump({'traceEvents': metadata + self.trace_events, 'displayTimeUnit': 'ms'}, f)
+        print(f"Trace written to {self.trace_file}")
+    
     def run_analyzer(self, c_file, mcu="atmega328p", ram_size=2048, optimization="O0"):
         """Palaiž analizatoru vienam C failam"""
         cmd = [
@@ -42,6 +108,25 @@ class BatchStackAnalyzer:
             "-l", "warning"  # Tikai svarīgus paziņojumus
         ]
         
+        if self.cache_dir:
+            cmd.extend(["--cache-dir", self.cache_dir])
+        
+        child_trace = None
+        if self.trace_file:
+            fd, child_trace = tempfile.mkstemp(prefix="avr_stack_trace_", suffix=".json")
+            os.close(fd)
+            cmd.extend(["--trace", child_trace])
+            self.trace_event('B', 'analyze file', {'file': os.path.basename(c_file)})
+        
+        try:
+            return self.execute_analyzer(cmd, c_file)
+        finally:
+            if child_trace:
+                self.merge_child_trace(child_trace)
+                self.trace_event('E', 'analyze file')
+    
+    def execute_analyzer(self, cmd, c_file):
+        """Izpilda analizatora komandu un atgriež tās izvadi"""
         try:
             result = subprocess.run(
                 cmd,
@@ -115,22 +200,32 @@ class BatchStackAnalyzer:
         print(f"Found {len(c_files)} C files to analyze...")
         print("=" * 100)
         
-        for c_file in c_files:
-            print(f"Analyzing {c_file}...", end=" ", flush=True)
-            
-            output = self.run_analyzer(c_file, mcu, ram_size, optimization)
-            result = self.parse_results(output, os.path.basename(c_file))
+        # Paralēli palaiž analizatoru; izvade tiek drukāta failu secībā
+        with ThreadPoolExecutor(max_workers=self.jobs) as executor:
+            outputs = executor.map(lambda c_file: self.run_analyzer(c_file, mcu, ram_size, optimization), c_files)
             
-            if result:
-                self.results.append(result)
-                if result['success']:
-                    print("✓ Done")
-                else:
-                    print(f"✗ Failed: {result.get('error', 'Unknown error')}")
-            else:
-                print("✗ Failed to run analyzer")
+            for c_file, output in zip(c_files, outputs):
+                self.report_file_result(c_file, output)
         
         print("=" * 100)
+        
+        if self.trace_file:
+            self.write_trace()
+    
+    def report_file_result(self, c_file, output):
+        """Parsē un izdrukā viena faila analīzes rezultātu"""
+        print(f"Analyzing {c_file}...", end=" ", flush=True)
+        
+        result = self.parse_results(output, os.path.basename(c_file))
+        
+        if result:
+            self.results.append(result)
+            if result['success']:
+                print("✓ Done")
+            else:
+                print(f"✗ Failed: {result.get('error', 'Unknown error')}")
+        else:
+            print("✗ Failed to run analyzer")
     
     def print_summary(self):
         """Izvada kompaktu rezultātu pārskatu"""
@@ -172,8 +267,24 @@ class BatchStackAnalyzer:
             print("-" * 20)
             print(f"Successfully analyzed: {len(successful_results)}/{len(self.results)} files")
 
+def positive_int(value):
+    """argparse tips pozitīvam veselam skaitlim (paralēlo procesu skaitam)."""
+    try:
+        number = int(value)
+    except ValueError:
+        raise argparse.ArgumentTypeError(f"invalid integer value: '{value}'")
+    if number < 1:
+        raise argparse.ArgumentTypeError(f"must be at least 1, got {number}")
+    return number
+
 def main():
     """Galvenā funkcija"""
+    parser = argparse.ArgumentParser(description="Run the AVR stack analyzer on all C files in the current directory")
+    parser.add_argument("-j", "--jobs", type=positive_int, default=1, help="Number of parallel analyzer processes (default: 1)")
+    parser.add_argument("--trace", help="Write a Chrome trace-event JSON file for the whole batch")
+    parser.add_argument("--cache-dir", help="Directory for caching intermediate analysis artifacts")
+    args = parser.parse_args()
+    
     print("AVR Stack Analysis Batch Runner")
     print("=" * 40)
     
@@ -183,7 +294,12 @@ def main():
     OPTIMIZATION = "O0"
     
     # Inicializē analizatoru
-    analyzer = BatchStackAnalyzer("avr-stack-analyzer-static.py")
+    analyzer = BatchStackAnalyzer(
+        "avr-stack-analyzer-static.py",
+        jobs=args.jobs,
+        trace_file=args.trace,
+        cache_dir=args.cache_dir
+    )
     
     # Analizē visus failus
     analyzer.analyze_all_files(
@@ -0,0 +1,741 @@
+"""
+Analizatora aprēķinu vienībtesti ar nelieliem assemblera teksta un izsaukumu grafa piemēriem.
+AVR rīki (avr-gcc, avr-objdump) nav nepieciešami.
+
+Izmantošana:
+python3 unit_test.py
+python3 unit_test.py -v HeapBoundTest
+"""
+
+import contextlib
+import importlib.util
+import io
+import os
+import shutil
+import struct
+import sys
+import tempfile
+import unittest
+from collections import Counter
+from dataclasses import replace
+from types import SimpleNamespace
+from unittest import mock
+
+ANALYZER_SCRIPT = os.path.join(os.path.dirname(os.path.abspath(__file__)), "avr-stack-analyzer-static.py")
+
+
+def load_analyzer_module(path=ANALYZER_SCRIPT):
+    """Ielādē analizatora skriptu kā moduli (faila nosaukumā ir defises)."""
+    spec = importlib.util.spec_from_file_location("avr_stack_analyzer", path)
+    module = importlib.util.module_from_spec(spec)
+    sys.modules[spec.name] = module
+    spec.loader.exec_module(module)
+    return module
+
+
+analyzer_module = load_analyzer_module()
+
+
+def make_analyzer_artifact(source_content="", mcu_type="atmega328p"):
+    """BuildArtifact ar tukšu ELF attēlu analizatora izveidei bez kompilācijas."""
+    return analyzer_module.BuildArtifact(
+        key="test", source_file="test.c", source_content=source_content, mcu_type=mcu_type,
+        optimization="O0", compiler_flags=(), elf_image=b"", stack_usage=()
+    )
+
+
+def make_analyzer(source_content="", mcu_type="atmega328p"):
+    """Izveido analizatoru bez kompilācijas (for_artifact ar tukšu ELF attēlu)."""
+    return analyzer_module.AVRCStackAnalyzer.for_artifact(make_analyzer_artifact(source_content, mcu_type))
+
+
+def asm(*functions):
+    """
+    Izveido avr-objdump formāta tekstu. Katra funkcija: (nosaukums, adrese, [instrukcija, ...]),
+    instrukcija: "ldi r24, 0x0A" vai ("call 0x120", "0x120 <malloc>") ar komentāru.
+    call/jmp/lds/sts aizņem 4 baitus, pārējās - 2.
+    """
+    lines = []
+    for name, address, instructions in functions:
+        lines.append(f"{address:08x} <{name}>:")
+        for instruction in instructions:
+            text, comment = (instruction, None) if isinstance(instruction, str) else instruction
+            size = 4 if text.split()[0] in ('call', 'jmp', 'lds', 'sts') else 2
+            encoding = " ".join(["00"] * size)
+            lines.append(f" {address:x}:\t{encoding} \t{text}" + (f"\t; {comment}" if comment else ""))
+            address += size
+        lines.append("")
+    return "\n".join(lines)
+
+
+class RegisterTrackingTest(unittest.TestCase):
+    def test_call_clobbers_argument_registers(self):
+        registers = {}
+        for text in ("ldi r24, 0x0A", "ldi r25, 0x00", "ldi r16, 0x05"):
+            analyzer_module.track_register_constants(f" 100:\t00 00 \t{text}", registers)
+        self.assertEqual(analyzer_module.register_pair_value(registers, 24), 10)
+        analyzer_module.track_register_constants(" 102:\t00 00 00 00 \tcall\t0x200\t; 0x200 <get_len>", registers)
+        self.assertIsNone(analyzer_module.register_pair_value(registers, 24))
+        # r16 ir izsauktās funkcijas saglabājams reģistrs
+        self.assertEqual(registers.get(16), 5)
+
+    def test_rcall_zero_is_not_a_call(self):
+        registers = {24: 1, 25: 0}
+        analyzer_module.track_register_constants(" 100:\t00 d0 \trcall\t.+0\t; 0x102 <main+0x2>", registers)
+        self.assertEqual(analyzer_module.register_pair_value(registers, 24), 1)
+
+
+class CompilerFlagsTest(unittest.TestCase):
+    def test_relative_paths_become_absolute(self):
+        flags = analyzer_module.absolute_path_flags(
+            ['-Iinc', '-I', 'lib', '-DBUF=64', '-include', 'config.h', '-L/opt/avr/lib', '-isystem', 'vendor']
+        )
+        cwd = os.getcwd()
+        self.assertEqual(flags, [
+            f"-I{cwd}/inc", '-I', f"{cwd}/lib", '-DBUF=64', '-include', f"{cwd}/config.h",
+            '-L/opt/avr/lib', '-isystem', f"{cwd}/vendor"
+        ])
+
+    def test_relative_paths_against_base_dir(self):
+        flags = analyzer_module.absolute_path_flags(['-Iinc', '-include', 'config.h', '-I/opt/avr/include'], "/work/rev")
+        self.assertEqual(flags, ['-I/work/rev/inc', '-include', '/work/rev/config.h', '-I/opt/avr/include'])
+
+
+class StackBisectTest(unittest.TestCase):
+    history = [f"c{index:02d}" for index in range(10)]
+
+    def setUp(self):
+        spec = importlib.util.spec_from_file_location(
+            "stack_bisect", os.path.join(os.path.dirname(ANALYZER_SCRIPT), "stack_bisect.py")
+        )
+        self.stack_bisect = importlib.util.module_from_spec(spec)
+        spec.loader.exec_module(self.stack_bisect)
+        patcher = mock.patch.object(self.stack_bisect, 'git', side_effect=self.git)
+        patcher.start()
+        self.addCleanup(patcher.stop)
+
+    def git(self, repo, *args):
+        """git aizstājējs: lineāra vēsture c00..c09, worktree komandas neko nedara."""
+        if args[0] == 'rev-parse':
+            return repo if args[1] == '--show-toplevel' else args[2].split('^')[0]
+        if args[0] == 'rev-list':
+            return "\n".join(self.history[1:])
+        return ""
+
+    def make_bisect(self, threshold, jobs, usage, skip=()):
+        """StackBisect ar kešotiem rezultātiem katrai revīzijai (kešotais statuss ir citam slieksnim)."""
+        bisect = self.stack_bisect.StackBisect(
+            analyzer_module, "/repo", "main.c", threshold, jobs=jobs, cache_file=None
+        )
+        self.addCleanup(shutil.rmtree, bisect.worktree_base, True)
+        for sha, max_stack_usage in zip(self.history, usage):
+            if sha in skip:
+                result = {'status': 'skip', 'error': "Compilation failed", 'deterministic': True}
+            else:
+                result = {'status': 'good', 'max_stack_usage': max_stack_usage, 'raw_max_usage': max_stack_usage,
+                          'function_usage': {}}
+            bisect.results[bisect.config_key(sha)] = result
+        return bisect
+
+    def run_bisect(self, bisect):
+        with mock.patch.object(bisect, 'evaluate', wraps=bisect.evaluate) as evaluate:
+            with contextlib.redirect_stdout(io.StringIO()):
+                outcome = bisect.run("c00", "c09")
+        return outcome, [call.args[1] for call in evaluate.call_args_list]
+
+    def test_linear_history(self):
+        bisect = self.make_bisect(200, 3, [100] * 6 + [300] * 4)
+        (last_good, first_bad, skipped, results), calls = self.run_bisect(bisect)
+        self.assertEqual((last_good, first_bad, skipped), ("c05", "c06", []))
+        self.assertLess(sum(len(shas) for shas in calls), len(self.history))
+        self.assertTrue(all(len(shas) <= 3 for shas in calls[1:]))
+
+    def test_skipped_revision_next_to_boundary(self):
+        bisect = self.make_bisect(200, 3, [100] * 6 + [300] * 4, skip=("c06",))
+        (last_good, first_bad, skipped, _), _ = self.run_bisect(bisect)
+        self.assertEqual((last_good, first_bad, skipped), ("c05", "c07", ["c06"]))
+
+    def test_cached_result_uses_current_threshold(self):
+        # Kešā visas revīzijas ir 'good' (iepriekšējā palaišana ar lielāku slieksni)
+        bisect = self.make_bisect(250, 3, [100, 120, 140, 160, 200, 240, 260, 280, 300, 320])
+        (last_good, first_bad, _, results), _ = self.run_bisect(bisect)
+        self.assertEqual((last_good, first_bad), ("c05", "c06"))
+        self.assertEqual(results["c09"]['status'], 'bad')
+        self.assertEqual(bisect.results[bisect.config_key("c09")]['status'], 'good')
+
+    def test_single_job_is_binary_search(self):
+        bisect = self.make_bisect(200, 1, [100] * 3 + [300] * 7)
+        (last_good, first_bad, _, _), calls = self.run_bisect(bisect)
+        self.assertEqual((last_good, first_bad), ("c02", "c03"))
+        self.assertTrue(all(len(shas) == 1 for shas in calls[1:]))
+
+    def test_path_flags_relative_to_worktree(self):
+        bisect = self.stack_bisect.StackBisect(
+            analyzer_module, "/repo", "src/main.c", 200, jobs=1, cache_file=None,
+            compiler_flags=['-Iinc', '-include', 'config.h', '-I/opt/avr/include', '-DBUF=64']
+        )
+        self.addCleanup(shutil.rmtree, bisect.worktree_base, True)
+        executor = mock.Mock()
+        executor.submit.return_value.result.return_value = {'status': 'skip', 'error': "Compilation failed"}
+        bisect.evaluate(executor, ["c01"])
+        worktree = os.path.join(bisect.worktree_base, "c01")
+        _, source_path, _, _, flags, _ = executor.submit.call_args.args
+        self.assertEqual(source_path, os.path.join(worktree, "src/main.c"))
+        self.assertEqual(flags, [f"-I{worktree}/inc", '-include', f"{worktree}/config.h", '-I/opt/avr/include', '-DBUF=64'])
+
+
+class SymbolIndexTest(unittest.TestCase):
+    index = analyzer_module.SymbolIndex(['log', 'log_data', 'process.constprop', 'main', 'filter', 'filter.isra.0'])
+
+    def test_resolve(self):
+        self.assertEqual(self.index.resolve('log'), 'log')
+        # .su ieraksts bez numura atbilst jebkuram šī veida klonam
+        self.assertEqual(self.index.resolve('process.constprop.0'), 'process.constprop')
+        # Numurēts .su ieraksts atbilst tikai tieši šim klonam
+        self.assertEqual(self.index.resolve('filter.isra.0'), 'filter.isra.0')
+        self.assertIsNone(self.index.resolve('filter.isra.1'))
+        self.assertIsNone(self.index.resolve('memcpy'))
+
+    def test_cold_part_belongs_to_its_function(self):
+        self.assertIsNone(self.index.resolve('main.cold'))
+        self.assertEqual(self.index.owner('main.cold'), 'main')
+        self.assertEqual(self.index.owner('process.constprop.cold'), 'process.constprop')
+
+    def test_origin(self):
+        self.assertEqual(self.index.origin('filter.isra.1'), 'filter')
+        self.assertEqual(self.index.origin('log_data.part.0'), 'log_data')
+        self.assertIsNone(self.index.origin('memcpy'))
+
+    def test_clone_without_su_entry_uses_decoded_frame(self):
+        code = asm(
+            ("filter", 0x100, ["push r16", "pop r16", "ret"]),
+            ("filter.isra.1", 0x110, ["push r16", "push r17", "push r28", "pop r28", "pop r17", "pop r16", "ret"]),
+            ("main", 0x130, [("call 0x110", "0x110 <filter.isra.1>"), "ret"]),
+        )
+        gcc_stack_usage = {'main': 2, 'filter': 1}
+        analyzer = make_analyzer()
+        usage = analyzer.resolve_function_stack_usage(code, gcc_stack_usage)
+        self.assertEqual(usage['filter.isra.1'], 5)
+        analyzer.link_call_graph({'main': ['filter.isra.1']}, usage, gcc_stack_usage, set())
+        self.assertEqual(usage['filter.isra.1'], 5)
+
+    def test_clone_without_su_entry_is_own_graph_node(self):
+        self.assertEqual(self.index.node('filter.isra.1'), 'filter.isra.1')
+        self.assertEqual(self.index.node('filter.isra.1.cold'), 'filter.isra.1')
+        self.assertEqual(self.index.node('main.cold'), 'main')
+        self.assertIsNone(self.index.node('memcpy'))
+
+        code = asm(
+            ("filter", 0x100, ["ret"]),
+            ("filter.isra.1", 0x110, [("call 0x150", "0x150 <leaf>"), ("call 0x110", "0x110 <filter.isra.1>"), "ret"]),
+            ("main", 0x130, [("call 0x110", "0x110 <filter.isra.1>"), "ret"]),
+            ("leaf", 0x150, ["ret"]),
+        )
+        gcc_stack_usage = {'filter': 2, 'main': 2, 'leaf': 2}
+        analyzer = make_analyzer()
+        call_graph = analyzer.build_call_graph(code, gcc_stack_usage)
+        self.assertEqual(call_graph['main'], ['filter.isra.1'])
+        self.assertEqual(call_graph['filter.isra.1'], ['leaf', 'filter.isra.1'])
+        self.assertEqual(call_graph['filter'], [])
+        self.assertEqual(analyzer.detect_recursion_from_assembly(code, gcc_stack_usage), {'filter.isra.1'})
+
+
+class HeapSitesTest(unittest.TestCase):
+    def test_constant_size(self):
+        code = asm(("main", 0x100, ["ldi r24, 0x40", "ldi r25, 0x00", ("call 0x300", "0x300 <malloc>"), "ret"]))
+        sites = make_analyzer().collect_heap_sites(code)
+        self.assertEqual(sites['main']['allocations'], [('malloc', 64, '104', 'constant', False, False)])
+
+    def test_size_clobbered_by_call(self):
+        code = asm(("main", 0x100, [
+            "ldi r24, 0x0A", "ldi r25, 0x00", ("call 0x200", "0x200 <get_len>"), ("call 0x300", "0x300 <malloc>"), "ret"
+        ]))
+        kind, size, _, source, _, _ = make_analyzer().collect_heap_sites(code)['main']['allocations'][0]
+        self.assertEqual((kind, size, source), ('malloc', None, 'unresolved'))
+
+    def test_size_unknown_at_branch_target(self):
+        # ldi r24 tiek izlaists, ja breq lec uz 0x108
+        code = asm(("main", 0x100, [
+            "ldi r24, 0x10", "ldi r25, 0x00", "breq .+2", "ldi r24, 0x20", ("call 0x300", "0x300 <malloc>"), "ret"
+        ]))
+        self.assertIsNone(make_analyzer().collect_heap_sites(code)['main']['allocations'][0][1])
+
+    def test_free_of_same_pointer_is_transient(self):
+        code = asm(("main", 0x100, [
+            "ldi r24, 0x10", "ldi r25, 0x00", ("call 0x300", "0x300 <malloc>"), "movw r16, r24",
+            "movw r24, r16", ("call 0x400", "0x400 <free>"), "ret"
+        ]))
+        self.assertTrue(make_analyzer().collect_heap_sites(code)['main']['allocations'][0][4])
+
+    def test_free_through_frame_slot(self):
+        code = asm(("main", 0x100, [
+            "in r28, 0x3d", "in r29, 0x3e", "ldi r24, 0x10", "ldi r25, 0x00", ("call 0x300", "0x300 <malloc>"),
+            "std Y+1, r24", "std Y+2, r25", ("call 0x200", "0x200 <work>"),
+            "ldd r24, Y+1", "ldd r25, Y+2", ("call 0x400", "0x400 <free>"), "ret"
+        ]))
+        self.assertTrue(make_analyzer().collect_heap_sites(code)['main']['allocations'][0][4])
+
+    def test_free_of_other_block_is_persistent(self):
+        # Pirmais bloks tiek saglabāts, atbrīvots tiek otrais
+        code = asm(("main", 0x100, [
+            "ldi r24, 0x10", "ldi r25, 0x00", ("call 0x300", "0x300 <malloc>"), "movw r16, r24",
+            "ldi r24, 0x08", "ldi r25, 0x00", ("call 0x300", "0x300 <malloc>"), ("call 0x400", "0x400 <free>"), "ret"
+        ]))
+        allocations = make_analyzer().collect_heap_sites(code)['main']['allocations']
+        self.assertEqual([allocation[4] for allocation in allocations], [False, True])
+
+    def test_allocation_in_loop(self):
+        code = asm(("main", 0x100, [
+            "ldi r24, 0x10", "ldi r25, 0x00", ("call 0x300", "0x300 <malloc>"), "rjmp .-10", "ret"
+        ]))
+        self.assertTrue(make_analyzer().collect_heap_sites(code)['main']['allocations'][0][5])
+
+
+class HeapBoundTest(unittest.TestCase):
+    @staticmethod
+    def persistent(size, looped=False):
+        return {'allocations': [('malloc', size, '100', 'constant', False, looped)], 'count': None}
+
+    def test_counted_per_call_path(self):
+        call_graph = {'main': ['a', 'b'], 'a': ['mk'], 'b': ['mk'], 'mk': []}
+        heap = make_analyzer().calculate_heap_bound({'mk': self.persistent(64)}, call_graph, set(), {})
+        self.assertEqual(heap['bound'], 132)
+
+    def test_counted_per_call_site(self):
+        call_graph = {'main': ['mk'], 'mk': []}
+        heap = make_analyzer().calculate_heap_bound(
+            {'mk': self.persistent(64)}, call_graph, set(), {}, call_sites={'main': {'mk': 3}}
+        )
+        self.assertEqual(heap['bound'], 198)
+
+    def test_call_in_loop_is_unknown(self):
+        call_graph = {'main': ['mk'], 'mk': []}
+        heap = make_analyzer().calculate_heap_bound(
+            {'mk': self.persistent(64)}, call_graph, set(), {}, call_sites={'main': {'mk': None}}
+        )
+        self.assertIsNone(heap['bound'])
+        self.assertEqual(heap['lower_bound'], 0)
+        self.assertEqual(len(heap['unresolved']), 1)
+
+    def test_allocation_in_loop_with_count_annotation(self):
+        sites = {'mk': self.persistent(64, looped=True)}
+        self.assertIsNone(make_analyzer().calculate_heap_bound(sites, {'main': ['mk'], 'mk': []}, set(), {})['bound'])
+        sites['mk']['count'] = 4
+        self.assertEqual(make_analyzer().calculate_heap_bound(sites, {'main': ['mk'], 'mk': []}, set(), {})['bound'], 264)
+
+    def test_recursion_is_unknown(self):
+        call_graph = {'main': ['rec'], 'rec': ['rec']}
+        heap = make_analyzer().calculate_heap_bound({'rec': self.persistent(8)}, call_graph, {'rec'}, {'rec': 5})
+        self.assertIsNone(heap['bound'])
+
+    def test_unknown_size_is_not_dropped(self):
+        sites = {'main': {'allocations': [('malloc', None, '100', 'unresolved', False, False),
+                                          ('malloc', 8, '108', 'constant', False, False)], 'count': None}}
+        heap = make_analyzer().calculate_heap_bound(sites, {'main': []}, set(), {})
+        self.assertIsNone(heap['bound'])
+        self.assertEqual(heap['lower_bound'], 10)
+
+    def test_transient_peak_along_worst_path(self):
+        sites = {'a': {'allocations': [('malloc', 30, '100', 'constant', True, True)], 'count': None},
+                 'b': {'allocations': [('malloc', 10, '100', 'constant', True, False)], 'count': None}}
+        heap = make_analyzer().calculate_heap_bound(sites, {'main': ['a', 'b'], 'a': [], 'b': []}, set(), {})
+        self.assertEqual(heap['bound'], 32)
+
+    def test_transient_peak_not_cached_inside_cycle(self):
+        # b tiek sasniegts vispirms cikla a -> b -> a iekšienē; c -> b ceļā jāizmanto pilnais b -> a maksimums
+        sites = {name: {'allocations': [('malloc', size, '100', 'constant', True, False)], 'count': None}
+                 for name, size in (('a', 30), ('b', 10), ('c', 100))}
+        call_graph = {'main': ['a', 'c'], 'a': ['b'], 'b': ['a'], 'c': ['b']}
+        heap = make_analyzer().calculate_heap_bound(sites, call_graph, set(), {})
+        self.assertEqual(heap['bound'], 102 + 12 + 32)
+
+
+class CallSitesTest(unittest.TestCase):
+    def test_counts_and_loops(self):
+        code = asm(
+            ("main", 0x100, [("call 0x200", "0x200 <mk>"), ("call 0x200", "0x200 <mk>"),
+                             ("call 0x220", "0x220 <poll>"), "rjmp .-6"]),
+            ("mk", 0x200, ["ret"]),
+            ("poll", 0x220, ["ret"]),
+        )
+        call_sites = make_analyzer().count_call_sites(code, {'main': 2, 'mk': 2, 'poll': 2})
+        self.assertEqual(call_sites['main'], {'mk': 2, 'poll': None})
+
+
+class WorstChainTest(unittest.TestCase):
+    def test_chain_independent_of_visit_order(self):
+        call_graph = {'main': ['a', 'b'], 'a': ['b'], 'b': ['a']}
+        usage = {'main': 1, 'a': 10, 'b': 20}
+        total, chain = make_analyzer().find_worst_chain('main', call_graph, usage, set(), {})
+        self.assertEqual(total, 31)
+        self.assertEqual(chain[0], ('main', 1))
+        self.assertEqual(sum(usage[func] * count for func, count in chain), total)
+
+    def test_recursion_multiplicity(self):
+        call_graph = {'main': ['helper', 'rec'], 'helper': ['leaf'], 'rec': ['rec'], 'leaf': []}
+        usage = {'main': 4, 'helper': 4, 'rec': 3, 'leaf': 8}
+        total, chain = make_analyzer().find_worst_chain('main', call_graph, usage, {'rec'}, {'rec': 11})
+        self.assertEqual(total, 37)
+        self.assertEqual(chain, [('main', 1), ('rec', 11)])
+
+    def test_cycle_head_reached_from_inside_cycle(self):
+        call_graph = {'main': ['a', 'c'], 'a': ['b'], 'b': ['a'], 'c': ['b']}
+        usage = {'main': 1, 'a': 30, 'b': 10, 'c': 100}
+        total, chain = make_analyzer().find_worst_chain('main', call_graph, usage, set(), {})
+        self.assertEqual(total, 141)
+        self.assertEqual(chain, [('main', 1), ('c', 1), ('b', 1), ('a', 1)])
+
+    def test_diamonds_above_cycle_are_memoized(self):
+        # 20 rombi virknē virs nerekursīva cikla: bez kešošanas tie būtu 2^20 ceļi
+        call_graph, usage = {}, {}
+        for level in range(20):
+            call_graph[f"n{level}"] = [f"l{level}", f"r{level}"]
+            call_graph[f"l{level}"] = [f"n{level + 1}"]
+            call_graph[f"r{level}"] = [f"n{level + 1}"]
+            usage.update({f"n{level}": 1, f"l{level}": 2, f"r{level}": 3})
+        call_graph.update({'n20': ['x'], 'x': ['y'], 'y': ['x']})
+        usage.update({'n20': 1, 'x': 5, 'y': 7})
+
+        visits = Counter()
+
+        class CountingGraph(dict):
+            def get(self, key, default=None):
+                visits[key] += 1
+                return super().get(key, default)
+
+        total, _ = make_analyzer().find_worst_chain('n0', CountingGraph(call_graph), usage, set(), {})
+        self.assertEqual(total, 20 * 4 + 1 + 5 + 7)
+        self.assertLessEqual(max(visits.values()), 2)
+
+
+class InterruptStackTest(unittest.TestCase):
+    call_graph = {'main': ['leaf'], 'leaf': [], '__vector_1': ['leaf'], '__vector_2': [], '__vector_3': []}
+    usage = {'main': 4, 'leaf': 6, '__vector_1': 4, '__vector_2': 20, '__vector_3': 5}
+
+    def calculate(self, vectors, xmega, enabled_levels=()):
+        model = {'xmega': xmega, 'vectors': vectors, 'enabled_levels': list(enabled_levels)}
+        return make_analyzer().calculate_interrupt_stack(model, 10, self.call_graph, self.usage, set(), {})
+
+    def test_classic_adds_largest_chain(self):
+        vectors = {vector: (None, 'unknown') for vector in ('__vector_1', '__vector_2', '__vector_3')}
+        interrupts = self.calculate(vectors, xmega=False)
+        self.assertEqual(interrupts['levels'], ((None, '__vector_2', 20),))
+        self.assertEqual(interrupts['interrupt_usage'], 20)
+
+    def test_xmega_levels_nest(self):
+        vectors = {'__vector_1': ('low', 'annotation'), '__vector_2': (None, 'unknown'), '__vector_3': ('high', 'INTCTRL')}
+        interrupts = self.calculate(vectors, xmega=True, enabled_levels=('low', 'medium', 'high'))
+        # Nezināmā līmeņa vektors tiek novietots brīvajā vidējā līmenī
+        self.assertEqual(interrupts['levels'], (('low', '__vector_1', 10), ('medium', '__vector_2', 20), ('high', '__vector_3', 5)))
+        self.assertEqual(interrupts['interrupt_usage'], 35)
+
+    def test_disabled_level_is_ignored(self):
+        vectors = {'__vector_1': ('low', 'annotation'), '__vector_3': ('high', 'INTCTRL')}
+        interrupts = self.calculate(vectors, xmega=True, enabled_levels=('high',))
+        self.assertEqual(interrupts['interrupt_usage'], 5)
+
+    def test_breakdown_includes_interrupt_chain(self):
+        analysis = {
+            'call_graph': self.call_graph, 'function_usage': self.usage, 'recursive_functions': [],
+            'recursion_limits': {}, 'interrupts': {'levels': ((None, '__vector_2', 20),)}
+        }
+        total, chains = make_analyzer().worst_case_chains(analysis)
+        self.assertEqual(total, 30)
+        self.assertEqual(chains, [[('main', 1), ('leaf', 1)], [('__vector_2', 1)]])
+        report = make_analyzer().generate_module_breakdown(analysis, {})
+        self.assertIn("__vector_2: 20 / 20 bytes (66.7% of worst path)", "\n".join(report))
+
+    @staticmethod
+    def levels(source):
+        analyzer = make_analyzer(source, mcu_type="atxmega128a1")
+        # Ierīces makrodefinīcijas no keša - avr-gcc netiek izsaukts
+        analyzer.device_cache['macros'] = "#define TCC0_OVF_vect_num 14\n"
+        return analyzer.collect_interrupt_levels("0000021c <__vector_14>:\n")
+
+    def test_pmic_bit_masks(self):
+        model = self.levels("TCC0.INTCTRLA = TC_OVFINTLVL_MED_gc;\nPMIC.CTRL = PMIC_LOLVLEN_bm | PMIC_MEDLVLEN_bm;")
+        self.assertEqual(model['vectors']['__vector_14'], ('medium', 'INTCTRL'))
+        self.assertEqual(model['enabled_levels'], ['low', 'medium'])
+
+    def test_pmic_numeric_value(self):
+        self.assertEqual(self.levels("PMIC.CTRL = 0x05;")['enabled_levels'], ['low', 'high'])
+
+    def test_unparsed_pmic_value_enables_all_levels(self):
+        with self.assertLogs(analyzer_module.logger, 'WARNING') as logs:
+            model = self.levels("PMIC.CTRL = MY_LEVELS;")
+        self.assertEqual(model['enabled_levels'], ['low', 'medium', 'high'])
+        self.assertIn("Could not parse PMIC.CTRL value 'MY_LEVELS'", logs.output[0])
+
+
+class DualImageTest(unittest.TestCase):
+    @staticmethod
+    def image(sections, stack_usage, heap=None):
+        solution = SimpleNamespace(max_stack_usage=stack_usage, heap=tuple(heap.items()) if heap else ())
+        return SimpleNamespace(section_headers=tuple(sections.items())), solution
+
+    def test_shared_mailbox(self):
+        images = {
+            'bootloader': self.image({'.data': (0x100, 0x10), '.noinit': (0x110, 4)}, 100),
+            'application': self.image({'.data': (0x100, 0x10), '.bss': (0x114, 0x20), '.noinit': (0x110, 4)}, 200),
+        }
+        result = analyzer_module.check_dual_image(images, 0x100, 2048)
+        self.assertEqual(result['problems'], [])
+        self.assertEqual(result['headroom'], 0x900 - 200 - 0x134)
+
+    def test_mailbox_overwritten(self):
+        images = {
+            'bootloader': self.image({'.data': (0x100, 0x10), '.noinit': (0x130, 4)}, 100),
+            'application': self.image({'.data': (0x100, 0x40), '.noinit': (0x240, 4)}, 100),
+        }
+        problems = analyzer_module.check_dual_image(images, 0x100, 2048)['problems']
+        self.assertEqual(len(problems), 2)
+        self.assertIn("overwrites bootloader .noinit", problems[1])
+
+    def test_stack_overlaps_statics(self):
+        images = {
+            'bootloader': self.image({'.bss': (0x100, 0x7f0)}, 32),
+            'application': self.image({}, 32),
+        }
+        result = analyzer_module.check_dual_image(images, 0x100, 2048)
+        self.assertEqual(result['headroom'], -16)
+        self.assertIn("bootloader: stack overlaps", result['problems'][0])
+
+    def test_heap_reduces_headroom(self):
+        heap = {'bound': 64, 'lower_bound': 64, 'unresolved': ()}
+        images = {
+            'bootloader': self.image({'.bss': (0x100, 0x10)}, 32),
+            'application': self.image({'.bss': (0x100, 0x20)}, 100, heap),
+        }
+        result = analyzer_module.check_dual_image(images, 0x100, 2048)
+        self.assertEqual(result['problems'], [])
+        self.assertEqual(result['headroom'], 0x900 - 100 - 0x120 - 64)
+
+    def test_unknown_heap_is_a_problem(self):
+        heap = {'bound': None, 'lower_bound': 16, 'unresolved': ('malloc at 0x1a4',)}
+        images = {
+            'bootloader': self.image({'.bss': (0x100, 0x10)}, 32),
+            'application': self.image({'.bss': (0x100, 0x20)}, 100, heap),
+        }
+        result = analyzer_module.check_dual_image(images, 0x100, 2048)
+        self.assertEqual(result['layout']['application']['headroom'], 0x900 - 100 - 0x120 - 16)
+        self.assertEqual(len(result['problems']), 1)
+        self.assertIn("application: heap size is UNKNOWN (malloc at 0x1a4)", result['problems'][0])
+
+
+class XmemPlacementTest(unittest.TestCase):
+    @staticmethod
+    def place(heap, external_size=0x8000, xram_end=0xffff):
+        image = SimpleNamespace(
+            section_headers=(('.data', (0x200, 0x100)), ('.bss', (0x300, 0x100))),
+            data_symbols=(('__heap_start', (0x400, 0, '.bss')),)
+        )
+        solution = SimpleNamespace(max_stack_usage=300, heap=tuple(heap.items()))
+        return analyzer_module.check_xmem_placement(image, solution, 0x200, 0x2000, 0x2200, external_size, xram_end=xram_end)
+
+    def test_fits(self):
+        result = self.place({'bound': 64, 'lower_bound': 64, 'unresolved': ()})
+        self.assertEqual(result['problems'], [])
+        self.assertEqual(result['headroom'], 0x2200 - 300 - 0x440)
+
+    def test_unresolved_heap_is_a_problem(self):
+        result = self.place({'bound': None, 'lower_bound': 64, 'unresolved': ('log (malloc at 0x1f0: size unknown)',)})
+        self.assertEqual(len(result['problems']), 1)
+        self.assertIn("heap size is UNKNOWN", result['problems'][0])
+
+    def test_external_beyond_xramend(self):
+        result = self.place({'bound': 0, 'lower_bound': 0, 'unresolved': ()}, external_size=0x10000)
+        self.assertIn("exceeds XRAMEND 0xffff", result['problems'][0])
+
+
+def dwarf_subprogram(offset, name, low_pc, params, variadic=False):
+    """DWARF subprogram DIE avr-objdump --dwarf=info formātā; params: [(nosaukums, tipa nobīde)]."""
+    lines = [f" <1><{offset:x}>: Abbrev Number: 7 (DW_TAG_subprogram)", f"    <{offset + 1:x}>   DW_AT_name        : {name}"]
+    if low_pc is not None:
+        lines.append(f"    <{offset + 2:x}>   DW_AT_low_pc      : 0x{low_pc:x}")
+    for index, (param, type_offset) in enumerate(params):
+        lines.append(f" <2><{offset + 0x10 + index:x}>: Abbrev Number: 8 (DW_TAG_formal_parameter)")
+        lines.append(f"    <{offset + 0x20 + index:x}>   DW_AT_name        : {param}")
+        lines.append(f"    <{offset + 0x30 + index:x}>   DW_AT_type        : <0x{type_offset:x}>")
+    if variadic:
+        lines.append(f" <2><{offset + 0x1f:x}>: Abbrev Number: 9 (DW_TAG_unspecified_parameters)")
+    return lines
+
+
+DWARF_TYPES = [
+    " <0><b>: Abbrev Number: 1 (DW_TAG_compile_unit)",
+    " <1><2d>: Abbrev Number: 2 (DW_TAG_base_type)",
+    "    <2e>   DW_AT_byte_size   : 4",
+    "    <30>   DW_AT_name        : long int",
+    " <1><34>: Abbrev Number: 2 (DW_TAG_base_type)",
+    "    <35>   DW_AT_byte_size   : 1",
+    "    <36>   DW_AT_name        : char",
+    " <1><40>: Abbrev Number: 4 (DW_TAG_structure_type)",
+    "    <41>   DW_AT_name        : S",
+    "    <42>   DW_AT_byte_size   : 12",
+]
+
+
+class ArgumentCostTest(unittest.TestCase):
+    def test_register_overflow(self):
+        prototype = {'variadic': False, 'return_size': 0, 'params': [(name, 4, False) for name in "abcde"]}
+        # Četri long aizņem 16 no 18 reģistru baitiem, piektais neietilpst
+        self.assertEqual(make_analyzer().classify_arguments(prototype), (4, 0))
+
+    def test_odd_size_uses_register_pair(self):
+        prototype = {'variadic': False, 'return_size': 0, 'params': [('c', 1, False)] * 9 + [('d', 1, False)]}
+        self.assertEqual(make_analyzer().classify_arguments(prototype), (1, 0))
+
+    def test_struct_and_varargs(self):
+        analyzer = make_analyzer()
+        self.assertEqual(analyzer.classify_arguments({'variadic': False, 'return_size': 0, 'params': [('s', 12, True)]}), (0, 12))
+        self.assertEqual(analyzer.classify_arguments({'variadic': True, 'return_size': 0, 'params': [('n', 2, False)]}), (2, 0))
+
+    def test_large_return_value_uses_hidden_argument(self):
+        params = [(name, 4, False) for name in "abcd"] + [('c', 1, False)]
+        # Bez slēptā argumenta visi 18 reģistru baiti pietiek
+        self.assertEqual(make_analyzer().classify_arguments({'variadic': False, 'return_size': 4, 'params': params}), (0, 0))
+        self.assertEqual(make_analyzer().classify_arguments({'variadic': False, 'return_size': 12, 'params': params}), (1, 0))
+
+    def test_static_functions_with_same_name(self):
+        # Divās kompilācijas vienībās ir static fmt ar atšķirīgiem argumentiem
+        dwarf = "\n".join(
+            DWARF_TYPES
+            + dwarf_subprogram(0x60, "fmt", 0x200, [(name, 0x2d) for name in "abcde"])
+            + [" <0><100>: Abbrev Number: 1 (DW_TAG_compile_unit)"]
+            + dwarf_subprogram(0x160, "fmt", 0x300, [("c", 0x34)])
+        )
+        analyzer = make_analyzer()
+        prototypes = analyzer.parse_dwarf_prototypes(dwarf)
+        self.assertEqual(sorted(prototypes['definitions']), [0x200, 0x300])
+        code = asm(
+            ("main", 0x100, [("call 0x200", "0x200 <fmt>"), ("call 0x300", "0x300 <fmt>"), "ret"]),
+            ("fmt", 0x200, ["ret"]),
+            ("fmt", 0x300, ["ret"]),
+        )
+        sites = analyzer.analyze_call_argument_costs(code, prototypes)
+        self.assertEqual([(site['address'], site['stack_bytes']) for site in sites], [('100', 4)])
+
+    def test_declaration_by_name(self):
+        dwarf = "\n".join(DWARF_TYPES + dwarf_subprogram(0x60, "printf", None, [("f", 0x2d)], variadic=True))
+        analyzer = make_analyzer()
+        code = asm(("main", 0x100, ["push r24", "push r25", ("call 0x400", "0x400 <printf>"), "ret"]))
+        sites = analyzer.analyze_call_argument_costs(code, analyzer.parse_dwarf_prototypes(dwarf))
+        self.assertEqual([(site['callee'], site['stack_bytes'], site['variadic']) for site in sites], [('printf', 4, True)])
+
+
+class StackFrameDecoderTest(unittest.TestCase):
+    def test_large_frame_subi_sbci(self):
+        code = asm(("big", 0x100, [
+            "push r28", "push r29", "in r28, 0x3d", "in r29, 0x3e", "subi r28, 0xC8", "sbci r29, 0x01",
+            "out 0x3e, r29", "out 0x3d, r28",
+            "subi r28, 0x38", "sbci r29, 0xFE", "out 0x3e, r29", "out 0x3d, r28", "pop r29", "pop r28", "ret"
+        ]))
+        usage = make_analyzer().analyze_function_stack_usage_from_asm(code)
+        self.assertEqual(usage['big'], 2 + 0x1C8 + 2)
+
+
+    def test_three_byte_return_address_on_avr6(self):
+        code = asm(("leaf", 0x100, ["push r28", "rcall .+0", "pop r0", "pop r0", "pop r0", "pop r28", "ret"]))
+        self.assertEqual(make_analyzer().analyze_function_stack_usage_from_asm(code)['leaf'], 1 + 2 + 2)
+        self.assertEqual(make_analyzer(mcu_type="atmega2560").analyze_function_stack_usage_from_asm(code)['leaf'], 1 + 3 + 3)
+
+    def test_return_address_from_elf_header(self):
+        code = asm(("leaf", 0x100, ["push r28", "pop r28", "ret"]))
+        # ELF32 galvene ar e_machine EM_AVR un e_flags arhitektūru avr6 (avr-objdump -f: avr:6)
+        header = b"\x7fELF\x01\x01\x01" + bytes(9) + struct.pack("<HHIIIII", 2, 83, 1, 0, 0, 0, 0x86)
+        build_artifact = replace(make_analyzer_artifact(mcu_type="atmega16"), elf_image=header)
+        analyzer = analyzer_module.AVRCStackAnalyzer.for_artifact(build_artifact)
+        self.assertEqual(analyzer.get_avr_architecture(), 'avr6')
+        self.assertEqual(analyzer.analyze_function_stack_usage_from_asm(code)['leaf'], 1 + 3)
+
+    def test_unknown_architecture_assumes_two_bytes(self):
+        code = asm(("leaf", 0x100, ["push r28", "pop r28", "ret"]))
+        analyzer = make_analyzer(mcu_type="atmega16")
+        # Bez ELF galvenes, ierīce nav tabulā un avr-gcc nav pieejams
+        with mock.patch.object(analyzer_module, 'run_tool', side_effect=OSError):
+            with self.assertLogs(analyzer_module.logger, 'WARNING') as logs:
+                self.assertEqual(analyzer.analyze_function_stack_usage_from_asm(code)['leaf'], 1 + 2)
+            self.assertEqual(analyzer.return_address_size(), 2)
+        self.assertEqual(len([line for line in logs.output if "assuming 2-byte return addresses" in line]), 1)
+
+    def test_interrupt_frame_from_su_when_available(self):
+        code = asm(("__vector_1", 0x100, ["push r1", "push r0", "push r24", "pop r24", "pop r0", "pop r1", "reti"]))
+        analyzer = make_analyzer()
+        self.assertEqual(analyzer.resolve_function_stack_usage(code, {'__vector_1': 9})['__vector_1'], 9)
+        # Attēlam bez .su datiem ietvars tiek dekodēts
+        self.assertEqual(analyzer.resolve_function_stack_usage(code, {'__vector_1': 0})['__vector_1'], 5)
+
+
+class RecoverFunctionsTest(unittest.TestCase):
+    # Attēls bez simboliem: reset kods pirms main izsauc inicializācijas funkciju,
+    # main beidzas ar astes izsaukumu (jmp) uz funkciju, ko izsauc arī pārtraukums
+    image = asm(
+        ("vectors", 0x0, ["jmp 0x10", "jmp 0x40"]),
+        ("reset", 0x10, ["eor r1, r1", ("call 0x30", "0x30"), ("call 0x50", "0x50"), ("jmp 0x70", "0x70")]),
+        ("init", 0x30, ["ldi r24, 0x01", "ret"]),
+        ("isr", 0x40, ["push r24", ("call 0x60", "0x60"), "pop r24", "reti"]),
+        ("main", 0x50, ["push r28", "pop r28", ("jmp 0x60", "0x60")]),
+        ("work", 0x60, ["push r16", "push r17", "pop r17", "pop r16", "ret"]),
+        ("exit", 0x70, ["cli", "rjmp .-4"]),
+    )
+
+    def recover(self):
+        analyzer = make_analyzer()
+        code, _ = analyzer.recover_functions(self.image)
+        return analyzer, code, analyzer_module.functions_from_asm(code)
+
+    def test_main_is_the_call_before_jump_to_exit(self):
+        _, code, functions = self.recover()
+        self.assertIn("00000050 <main>:", code)
+        self.assertEqual(sorted(functions), ['__vector_1', 'main', 'sub_00060'])
+
+    def test_tail_call_is_a_graph_edge(self):
+        analyzer, code, functions = self.recover()
+        call_graph = analyzer.build_call_graph(code, functions)
+        self.assertEqual(call_graph['main'], ['sub_00060'])
+        self.assertEqual(call_graph['__vector_1'], ['sub_00060'])
+        self.assertEqual(analyzer.count_call_sites(code, functions)['main'], {'sub_00060': 1})
+
+    def test_recursion_limit_override(self):
+        with self.assertRaisesRegex(RuntimeError, "--recursion-limit sub_00060=N"):
+            make_analyzer().analyze_recursion_depth({'sub_00060'})
+        build_artifact = analyzer_module.with_recursion_limits(
+            make_analyzer_artifact(), {'sub_00060': 6}
+        )
+        analyzer = analyzer_module.AVRCStackAnalyzer.for_artifact(build_artifact)
+        limits, reduction_info = analyzer.analyze_recursion_depth({'sub_00060'})
+        self.assertEqual(limits, {'sub_00060': 6})
+        self.assertEqual(reduction_info['sub_00060']['type'], 'override')
+
+
+class DifferentialShrinkTest(unittest.TestCase):
+    # Samazināšana nedrīkst pāriet no sākotnējās atšķirības uz citu
+    def test_shrink_keeps_original_difference(self):
+        spec = importlib.util.spec_from_file_location(
+            "differential_test", os.path.join(os.path.dirname(ANALYZER_SCRIPT), "differential_test.py")
+        )
+        differential = importlib.util.module_from_spec(spec)
+        spec.loader.exec_module(differential)
+
+        def compare(path):
+            with open(path) as f:
+                source = f.read()
+            if "uint8_t b(uint8_t n)" in source:
+                return {'staged': ['function_usage[b]: 4 != 6']}, {}, False
+            return {'staged': ['worst_case: 10 != 12']}, {}, False
+
+        program = differential.RandomProgram(
+            {'b': {'locals': 0, 'calls': [], 'recursion': None},
+             'a': {'locals': 0, 'calls': [], 'recursion': None}},
+            ['b', 'a']
+        )
+        with tempfile.TemporaryDirectory() as work_dir:
+            harness = differential.DifferentialHarness(None, ['regex', 'staged'], work_dir=work_dir)
+            harness.compare = compare
+            reduced, differences, _ = harness.shrink(program, 0, {'staged': ['function_usage[b]: 4 != 6']}, {})
+        self.assertEqual(sorted(reduced.functions), ['b'])
+        self.assertEqual(differences, {'staged': ['function_usage[b]: 4 != 6']})
+
+
+if __name__ == "__main__":
+    unittest.main()